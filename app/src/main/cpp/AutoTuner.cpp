@@ -0,0 +1,269 @@
+#include "AutoTuner.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <set>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#include "ModelPool.h"
+#include "ModelSession.h"
+#include "hash.h"
+#include "logging.h"
+#include "memory_usage.h"
+#include "profiler.h"
+#include "timing.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string trim(const std::string &s) {
+    const size_t b = s.find_first_not_of(" \t");
+    const size_t e = s.find_last_not_of(" \t\r\n");
+    return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+std::string describe(const RunnerSettings &s) {
+    std::ostringstream o;
+    // On the Env's global pools neither the thread count nor XNNPACK's pool choice applies
+    if (s.use_global_thread_pools)
+        o << "threads=global xnnpack=" << (s.use_xnnpack ? "on" : "off");
+    else
+        o << "threads=" << s.num_cpu_cores
+          << " xnnpack=" << (s.use_xnnpack ? (s.xnnpack.use_session_threads ? "session" : "own") : "off");
+    o << " nnapi=" << s.use_nnapi
+      << " opt=" << (s.use_layout_optimization_instead_of_extended ? "all" : "extended")
+      << " parallel=" << s.use_parallel_execution;
+    return o.str();
+}
+
+// Thread counts worth trying: powers of two up to the core count, plus the core count.
+std::vector<int> thread_candidates() {
+    const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> out;
+    for (int t = 1; t < cores; t *= 2) out.push_back(t);
+    out.push_back(cores);
+    return out;
+}
+
+// Better = faster beyond the tie tolerance, or a tie with lower peak memory.
+bool better(const TuneTrial &a, const TuneTrial &b, double tolerance) {
+    if (!a.ok) return false;
+    if (!b.ok) return true;
+    if (a.p50_ms < b.p50_ms * (1.0 - tolerance)) return true;
+    if (b.p50_ms < a.p50_ms * (1.0 - tolerance)) return false;
+    if (a.peak_rss_kb >= 0 && b.peak_rss_kb >= 0 && a.peak_rss_kb != b.peak_rss_kb)
+        return a.peak_rss_kb < b.peak_rss_kb;
+    return a.p50_ms < b.p50_ms;
+}
+
+} // namespace
+
+std::string device_description() {
+    std::set<std::string> cpu_names;
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    for (std::string line; std::getline(cpuinfo, line);) {
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        const std::string key = trim(line.substr(0, colon)), value = trim(line.substr(colon + 1));
+        if (key == "model name" || key == "Hardware" || key == "CPU part" || key == "CPU implementer")
+            cpu_names.insert(key + "=" + value);
+    }
+
+    // Core clusters by max frequency, e.g. 1800000x4,2400000x3,3000000x1
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::map<long, int> freqs;
+    for (unsigned c = 0; c < cores; ++c) {
+        std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(c) +
+                        "/cpufreq/cpuinfo_max_freq");
+        long khz = 0;
+        if (f >> khz) ++freqs[khz];
+    }
+
+    std::ostringstream o;
+    o << "cores=" << cores;
+    for (const auto &n: cpu_names) o << ";" << n;
+    o << ";freqs=";
+    for (auto it = freqs.begin(); it != freqs.end(); ++it)
+        o << (it == freqs.begin() ? "" : ",") << it->first << "x" << it->second;
+    return o.str();
+}
+
+std::string device_key() {
+    const std::string d = device_description();
+    return hash_to_hex(hash_bytes(d.data(), d.size()));
+}
+
+AutoTuner::AutoTuner(std::string profile_dir, std::string model_name, uint64_t model_hash)
+        : dir_(std::move(profile_dir)),
+          model_name_(fs::path(model_name).filename().string()) {
+    profile_path_ = (fs::path(dir_) / (model_name_ + "." + hash_to_hex(model_hash) + "." +
+                                       device_key() + ".profile")).string();
+}
+
+std::optional<RunnerSettings> AutoTuner::load(const RunnerSettings &base) const {
+    std::ifstream f(profile_path_);
+    if (!f) return std::nullopt;
+    std::map<std::string, std::string> kv;
+    for (std::string line; std::getline(f, line);) {
+        if (line.empty() || line[0] == '#') continue;
+        const size_t eq = line.find('=');
+        if (eq != std::string::npos) kv[line.substr(0, eq)] = trim(line.substr(eq + 1));
+    }
+    try {
+        // Thread settings tuned for one pool mode say nothing about the other (and profiles
+        // tuned on global pools carry none), so a mismatched profile counts as missing
+        const bool global = kv.count("global_thread_pools") && kv.at("global_thread_pools") == "1";
+        if (global != base.use_global_thread_pools) {
+            LOGI("[TUNE] %s was tuned %s global thread pools, ignoring it", profile_path_.c_str(),
+                 global ? "on" : "without");
+            return std::nullopt;
+        }
+        RunnerSettings s = base;
+        s.use_xnnpack = kv.at("use_xnnpack") == "1";
+        if (!global) {
+            s.num_cpu_cores = std::stoi(kv.at("num_cpu_cores"));
+            s.xnnpack.use_session_threads = kv.at("xnnpack_session_threads") == "1";
+        }
+        s.use_nnapi = kv.at("use_nnapi") == "1";
+        s.use_parallel_execution = kv.at("use_parallel_execution") == "1";
+        s.use_layout_optimization_instead_of_extended = kv.at("use_layout_optimization") == "1";
+        LOGI("[TUNE] loaded %s: %s", profile_path_.c_str(), describe(s).c_str());
+        return s;
+    } catch (const std::exception &e) {
+        LOGE("[TUNE] ignoring malformed profile %s: %s", profile_path_.c_str(), e.what());
+        return std::nullopt;
+    }
+}
+
+RunnerSettings AutoTuner::tune(const RunnerSettings &base, const PoolFactory &make_pools,
+                               const std::vector<uint8_t> &image, const std::vector<uint8_t> &mask,
+                               const TuneOptions &opts) {
+    trials_.clear();
+    RunnerSettings start = base;
+    start.optimized_model_cache_dir.clear(); // do not fill the cache with losing variants
+    start.use_nnapi = false;
+
+    TuneTrial best = measure_(start, make_pools, image, mask, opts);
+    auto sweep = [&](const std::vector<std::function<void(RunnerSettings &)>> &variants) {
+        const RunnerSettings anchor = best.settings;
+        for (const auto &apply: variants) {
+            RunnerSettings s = anchor;
+            apply(s);
+            if (describe(s) == describe(anchor)) continue; // already measured
+            TuneTrial t = measure_(s, make_pools, image, mask, opts);
+            if (better(t, best, opts.tie_tolerance)) best = t;
+        }
+    };
+
+    // Global pools are sized by the runner: thread count and XNNPACK's own pool are moot
+    const bool global = base.use_global_thread_pools;
+    std::vector<std::function<void(RunnerSettings &)>> threads;
+    if (!global) {
+        for (int n: thread_candidates())
+            threads.emplace_back([n](RunnerSettings &s) { s.num_cpu_cores = n; });
+    }
+    sweep(threads);
+    if (global)
+        sweep({[](RunnerSettings &s) { s.use_xnnpack = false; },
+               [](RunnerSettings &s) { s.use_xnnpack = true; }});
+    else
+        sweep({[](RunnerSettings &s) { s.use_xnnpack = false; },
+               [](RunnerSettings &s) { s.use_xnnpack = true; s.xnnpack.use_session_threads = false; },
+               [](RunnerSettings &s) { s.use_xnnpack = true; s.xnnpack.use_session_threads = true; }});
+    sweep({[](RunnerSettings &s) { s.use_layout_optimization_instead_of_extended = false; },
+           [](RunnerSettings &s) { s.use_layout_optimization_instead_of_extended = true; }});
+    sweep({[](RunnerSettings &s) { s.use_parallel_execution = false; },
+           [](RunnerSettings &s) { s.use_parallel_execution = true; }});
+    if (opts.include_nnapi)
+        sweep({[](RunnerSettings &s) { s.use_nnapi = true; }});
+    // Thread count again: the best count often moves once XNNPACK owns the threads
+    sweep(threads);
+
+    if (!best.ok) throw std::runtime_error("AutoTuner: no candidate settings could run");
+    store_(best);
+
+    RunnerSettings out = best.settings;
+    out.optimized_model_cache_dir = base.optimized_model_cache_dir;
+    return out;
+}
+
+TuneTrial AutoTuner::measure_(const RunnerSettings &s, const PoolFactory &make_pools,
+                              const std::vector<uint8_t> &image, const std::vector<uint8_t> &mask,
+                              const TuneOptions &opts) {
+    TuneTrial t;
+    t.settings = s;
+    try {
+        reset_peak_rss();
+        const long base_kb = read_memory_usage().rss_kb;
+        {
+            const auto pools = make_pools(s);
+            for (const auto &pool: pools)
+                for (size_t r = 0; r < pool->size(); ++r)
+                    pool->replica(r)->set_result_cache(nullptr); // every iteration must really run
+
+            // One request per replica of every pool at once; latency of each request
+            auto round = [&](std::vector<double> *ms) {
+                std::vector<std::future<double>> running;
+                for (const auto &pool: pools)
+                    for (size_t r = 0; r < pool->size(); ++r)
+                        running.push_back(std::async(std::launch::async, [&image, &mask, pool] {
+                            auto t0 = StageClock::now();
+                            pool->runEndToEnd(image, mask);
+                            return elapsed_ms(t0);
+                        }));
+                for (auto &f: running) {
+                    const double v = f.get();
+                    if (ms) ms->push_back(v);
+                }
+            };
+            for (int i = 0; i < opts.warmup; ++i) round(nullptr);
+            std::vector<double> ms;
+            for (int i = 0; i < std::max(1, opts.iters); ++i) round(&ms);
+            t.p50_ms = summarize_ms(std::move(ms)).p50_ms;
+        }
+        const long peak_kb = read_memory_usage().peak_rss_kb;
+        t.peak_rss_kb = base_kb < 0 || peak_kb < 0 ? -1 : peak_kb - base_kb;
+        t.ok = true;
+        LOGI("[TUNE] %s -> p50=%.1f ms peak=+%ld KiB", describe(s).c_str(), t.p50_ms, t.peak_rss_kb);
+    } catch (const std::exception &e) {
+        LOGE("[TUNE] %s failed: %s", describe(s).c_str(), e.what());
+    }
+    trials_.push_back(t);
+    return t;
+}
+
+void AutoTuner::store_(const TuneTrial &best) const {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    const std::string tmp = profile_path_ + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        const RunnerSettings &s = best.settings;
+        f << "# cpponnxrunner tuned RunnerSettings\n"
+          << "device=" << device_description() << "\n"
+          << "model=" << model_name_ << "\n"
+          << "use_xnnpack=" << s.use_xnnpack << "\n"
+          << "global_thread_pools=" << s.use_global_thread_pools << "\n";
+        if (!s.use_global_thread_pools)
+            f << "num_cpu_cores=" << s.num_cpu_cores << "\n"
+              << "xnnpack_session_threads=" << s.xnnpack.use_session_threads << "\n";
+        f << "use_nnapi=" << s.use_nnapi << "\n"
+          << "use_parallel_execution=" << s.use_parallel_execution << "\n"
+          << "use_layout_optimization=" << s.use_layout_optimization_instead_of_extended << "\n"
+          << "p50_ms=" << best.p50_ms << "\n"
+          << "peak_rss_kb=" << best.peak_rss_kb << "\n";
+        if (!f) {
+            LOGE("[TUNE] cannot write %s", tmp.c_str());
+            return;
+        }
+    }
+    fs::rename(tmp, profile_path_, ec);
+    if (ec) LOGE("[TUNE] cannot publish %s: %s", profile_path_.c_str(), ec.message().c_str());
+    else LOGI("[TUNE] stored %s: %s", profile_path_.c_str(), describe(best.settings).c_str());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+class ModelPool;
+
+struct TuneOptions {
+    int  warmup = 1;
+    int  iters  = 3;
+    bool include_nnapi = false;
+    // Latencies within this fraction of the best count as a tie, broken by lower peak RSS
+    double tie_tolerance = 0.03;
+};
+
+// One measured RunnerSettings candidate.
+struct TuneTrial {
+    RunnerSettings settings;
+    double p50_ms = 0;
+    long peak_rss_kb = -1;
+    bool ok = false;
+};
+
+// Finds the fastest RunnerSettings for one model on this device and remembers it.
+//
+// The sweep is a coordinate descent over thread count, XNNPACK (off / own threads /
+// session threads), graph optimization level and sequential vs parallel execution
+// (with RunnerSettings::use_global_thread_pools, just XNNPACK off / on and the rest):
+// each dimension is tried in turn with the others held at the best values so far, which
+// needs ~10 builds instead of the full cross product. Each trial builds everything the app
+// deploys (every model's pool) and times one concurrent request per replica, so thread
+// budgets are judged under the contention they will see. Profiles are stored as
+// `<dir>/<model name>.<model hash>.<device key>.profile`, so a later start loads instead
+// of tuning, and a new model under the same name is tuned afresh. A profile records
+// whether it was tuned on global thread pools; load() ignores one tuned for the other mode.
+class AutoTuner {
+public:
+    // The deployed pools for given settings.
+    using PoolFactory = std::function<std::vector<std::shared_ptr<ModelPool>>(const RunnerSettings &)>;
+
+    // `model_hash`: content hash of the model (InferenceRunner::model_hash).
+    AutoTuner(std::string profile_dir, std::string model_name, uint64_t model_hash);
+
+    // Stored profile applied on top of `base`, or nullopt when this device has none.
+    std::optional<RunnerSettings> load(const RunnerSettings &base) const;
+
+    // Runs the sweep on a representative (image, mask) pair, stores and returns the winner.
+    RunnerSettings tune(const RunnerSettings &base, const PoolFactory &make_pools,
+                        const std::vector<uint8_t> &image, const std::vector<uint8_t> &mask,
+                        const TuneOptions &opts = {});
+
+    const std::vector<TuneTrial> &trials() const { return trials_; }
+
+    const std::string &profile_path() const { return profile_path_; }
+
+private:
+    TuneTrial measure_(const RunnerSettings &s, const PoolFactory &make_pools,
+                       const std::vector<uint8_t> &image, const std::vector<uint8_t> &mask,
+                       const TuneOptions &opts);
+
+    void store_(const TuneTrial &best) const;
+
+    std::string dir_;
+    std::string model_name_;
+    std::string profile_path_;
+    std::vector<TuneTrial> trials_;
+};
+
+// Human-readable CPU description (cores, CPU parts / model name, max frequency per core).
+std::string device_description();
+
+// Short stable key of device_description().
+std::string device_key();
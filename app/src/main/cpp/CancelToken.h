@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+#include <onnxruntime_cxx_api.h>
+
+// Thrown by model passes of a cancelled request.
+class RunCancelled : public std::runtime_error {
+public:
+    RunCancelled() : std::runtime_error("run cancelled") {}
+};
+
+// Cancellation of one request. Passes running under run_options() stop at the next op
+// boundary (RunOptions::SetTerminate), passes not started yet are skipped; either way
+// the request ends with RunCancelled. One token per request: it cannot be re-armed.
+class CancelToken {
+public:
+    // Safe from any thread, also before or after the request ran.
+    void cancel() {
+        cancelled_ = true;
+        run_options_.SetTerminate();
+    }
+
+    bool cancelled() const { return cancelled_; }
+
+    void throw_if_cancelled() const {
+        if (cancelled_) throw RunCancelled();
+    }
+
+    Ort::RunOptions &run_options() { return run_options_; }
+
+private:
+    std::atomic<bool> cancelled_{false};
+    Ort::RunOptions run_options_;
+};
@@ -0,0 +1,126 @@
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sched.h>
+#include <thread>
+#include <utility>
+
+namespace {
+    // First integer in a sysfs file, -1 when missing (offline core, no cpufreq driver)
+    long read_long(const std::string &path) {
+        FILE *f = std::fopen(path.c_str(), "r");
+        if (!f) return -1;
+        long v = -1;
+        if (std::fscanf(f, "%ld", &v) != 1) v = -1;
+        std::fclose(f);
+        return v;
+    }
+
+    // sysfs cpu list, e.g. "0-3,5,7-8"
+    std::vector<int> read_cpu_list(const std::string &path) {
+        std::vector<int> cpus;
+        FILE *f = std::fopen(path.c_str(), "r");
+        if (!f) return cpus;
+        int from = 0, to = 0;
+        while (std::fscanf(f, "%d", &from) == 1) {
+            to = from;
+            int c = std::fgetc(f);
+            if (c == '-') {
+                if (std::fscanf(f, "%d", &to) != 1) break;
+                c = std::fgetc(f);
+            }
+            for (int i = from; i <= to; ++i) cpus.push_back(i);
+            if (c != ',') break;
+        }
+        std::fclose(f);
+        return cpus;
+    }
+
+    std::string cpu_ranges(const std::vector<int> &cpus) {
+        std::string out;
+        for (size_t i = 0; i < cpus.size();) {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+            if (!out.empty()) out += ',';
+            out += std::to_string(cpus[i]);
+            if (j > i) out += '-' + std::to_string(cpus[j]);
+            i = j + 1;
+        }
+        return out;
+    }
+}
+
+CpuTopology CpuTopology::detect(const std::string &sysfs_cpu_dir) {
+    std::vector<int> online = read_cpu_list(sysfs_cpu_dir + "/online");
+    if (online.empty()) {
+        const unsigned n = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < n; ++i) online.push_back(static_cast<int>(i));
+    }
+
+    // (capacity, max freq) -> cores; ordered so that rbegin() is the fastest kind
+    std::map<std::pair<long, long>, std::vector<int>> kinds;
+    for (int cpu: online) {
+        const std::string dir = sysfs_cpu_dir + "/cpu" + std::to_string(cpu);
+        const long capacity = std::max(0L, read_long(dir + "/cpu_capacity"));
+        const long freq = std::max(0L, read_long(dir + "/cpufreq/cpuinfo_max_freq"));
+        kinds[{capacity, freq}].push_back(cpu);
+    }
+
+    CpuTopology t;
+    for (auto it = kinds.rbegin(); it != kinds.rend(); ++it) {
+        t.clusters_.push_back(CpuCluster{std::move(it->second), it->first.first, it->first.second});
+    }
+    return t;
+}
+
+std::vector<int> CpuTopology::all_cpus() const {
+    std::vector<int> cpus;
+    for (const auto &c: clusters_) cpus.insert(cpus.end(), c.cpus.begin(), c.cpus.end());
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+std::vector<int> CpuTopology::performance_cpus() const {
+    if (!heterogeneous()) return all_cpus();
+    std::vector<int> cpus;
+    for (size_t i = 0; i + 1 < clusters_.size(); ++i)
+        cpus.insert(cpus.end(), clusters_[i].cpus.begin(), clusters_[i].cpus.end());
+    std::sort(cpus.begin(), cpus.end());
+    return cpus;
+}
+
+std::string CpuTopology::describe() const {
+    std::string out;
+    for (const auto &c: clusters_) {
+        if (!out.empty()) out += ", ";
+        out += std::to_string(c.cpus.size()) + "x[" + cpu_ranges(c.cpus) + "]";
+        if (c.capacity) out += " cap " + std::to_string(c.capacity);
+        if (c.max_freq_khz) out += " " + std::to_string(c.max_freq_khz / 1000) + "MHz";
+    }
+    return out;
+}
+
+std::string ort_thread_affinity(const std::vector<int> &cpus, const int threads) {
+    if (threads <= 1 || cpus.empty()) return {};
+    // ORT numbers logical processors from 1
+    std::string set;
+    for (int cpu: cpus) {
+        if (!set.empty()) set += ',';
+        set += std::to_string(cpu + 1);
+    }
+    std::string out = set;
+    for (int i = 2; i < threads; ++i) out += ';' + set;
+    return out;
+}
+
+bool pin_current_thread(const std::vector<int> &cpus) {
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu: cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
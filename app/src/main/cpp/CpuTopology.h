@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Cores of one kind (same cpu_capacity and max frequency), e.g. the little cores of a
+// big.LITTLE SoC.
+struct CpuCluster {
+    std::vector<int> cpus;  // logical ids, as in /sys/devices/system/cpu/cpuN
+    long capacity = 0;      // cpu_capacity, relative to the biggest core (1024); 0 if unknown
+    long max_freq_khz = 0;  // cpufreq/cpuinfo_max_freq; 0 if unknown
+};
+
+// Online cores grouped into clusters from sysfs. Without capacity or frequency data
+// (emulators, some desktops) every core lands in one cluster.
+class CpuTopology {
+public:
+    static CpuTopology detect(const std::string &sysfs_cpu_dir = "/sys/devices/system/cpu");
+
+    // Fastest cluster first
+    const std::vector<CpuCluster> &clusters() const { return clusters_; }
+
+    bool heterogeneous() const { return clusters_.size() > 1; }
+
+    std::vector<int> all_cpus() const;
+
+    // Every cluster but the slowest; all cores on homogeneous CPUs.
+    std::vector<int> performance_cpus() const;
+
+    // e.g. "1x[7] cap 1024 3200MHz, 3x[4-6] cap 870 2800MHz, 4x[0-3] cap 325 2000MHz"
+    std::string describe() const;
+
+private:
+    std::vector<CpuCluster> clusters_;
+};
+
+// ORT intra-op affinity string (session.intra_op_thread_affinities / global threading
+// options) for a pool of `threads` threads kept on `cpus`: threads - 1 entries, since ORT
+// leaves the calling thread alone, each allowing the whole set so concurrent passes can
+// still be balanced by the kernel. Empty when threads <= 1 or cpus is empty.
+std::string ort_thread_affinity(const std::vector<int> &cpus, int threads);
+
+// Restricts the calling thread to `cpus`; false if the kernel refuses or cpus is empty.
+bool pin_current_thread(const std::vector<int> &cpus);
@@ -0,0 +1,175 @@
+#include "EditSession.h"
+
+#include <stdexcept>
+
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "CancelToken.h"
+#include "ModelPool.h"
+#include "ModelSession.h"
+#include "encode.h"
+#include "logging.h"
+#include "roi.h"
+#include "tiling.h"
+
+namespace {
+    cv::Mat decode(const std::vector<uint8_t> &bytes, int flags) {
+        if (bytes.empty()) throw std::invalid_argument("EditSession: empty input bytes");
+        cv::Mat buf(1, static_cast<int>(bytes.size()), CV_8UC1, const_cast<uint8_t *>(bytes.data()));
+        cv::Mat img = cv::imdecode(buf, flags);
+        if (img.empty()) throw std::runtime_error("EditSession: failed to decode image");
+        return img;
+    }
+}
+
+EditSession::EditSession(std::shared_ptr<ModelPool> pool, cv::Mat image)
+        : pool_(std::move(pool)), image_(std::move(image)) {
+    if (!pool_) throw std::invalid_argument("EditSession: null pool");
+    if (image_.empty() || image_.channels() != 3)
+        throw std::invalid_argument("EditSession: image must be non-empty BGR");
+    reset();
+}
+
+EditSession::EditSession(std::shared_ptr<ModelPool> pool, const std::vector<uint8_t> &imageBytes)
+        : EditSession(std::move(pool), decode(imageBytes, cv::IMREAD_COLOR)) {}
+
+void EditSession::reset() {
+    std::lock_guard<std::mutex> lk(m_);
+    mask_ = cv::Mat::zeros(image_.size(), CV_8UC1);
+    result_ = image_.clone();
+    patches_.clear();
+}
+
+cv::Mat EditSession::apply(const cv::Mat &mask, StageTimings *timings, CancelToken *cancel) {
+    if (mask.empty()) throw std::invalid_argument("EditSession: mask is empty");
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    std::lock_guard<std::mutex> lk(m_);
+
+    cv::Mat bin, changed;
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        bin = binarize_mask(mask, image_.size());
+        cv::bitwise_xor(bin, mask_, changed);
+    }
+    if (cv::countNonZero(changed) == 0) {
+        LOGI("[EDIT] mask unchanged, reusing result");
+        return result_.clone();
+    }
+
+    auto lease = pool_->acquire();
+    const RunnerSettings &s = lease->settings();
+    const cv::Size tile = lease->input_size();
+    const bool tiled = s.tiling.enabled && image_.cols >= tile.width && image_.rows >= tile.height;
+    cv::Mat out = tiled ? apply_tiled_(*lease, bin, changed, t, cancel)
+                        : apply_components_(*lease, bin, changed, t, cancel);
+
+    mask_ = bin;
+    result_ = out;
+    return out.clone();
+}
+
+cv::Mat EditSession::apply_tiled_(ModelSession &model, const cv::Mat &bin, const cv::Mat &changed,
+                                  StageTimings &t, CancelToken *cancel) {
+    const cv::Size tile_size = model.input_size();
+    const int overlap = model.settings().tiling.overlap_px;
+    std::vector<cv::Rect> tiles, dirty;
+    std::map<TileKey, cv::Mat> patches;
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        // Grid over the whole image, not the mask bbox, so tiles stay put as the mask grows
+        tiles = plan_tiles(cv::Rect(0, 0, image_.cols, image_.rows), bin, tile_size, overlap);
+        for (const auto &r: tiles) {
+            // The image never changes: a tile's output only depends on its mask crop
+            auto it = patches_.find({r.x, r.y});
+            if (it != patches_.end() && cv::countNonZero(changed(r)) == 0)
+                patches.emplace(it->first, it->second);
+            else
+                dirty.push_back(r);
+        }
+    }
+    LOGI("[EDIT] changed=%d px, recomputing %zu of %zu tiles",
+         cv::countNonZero(changed), dirty.size(), tiles.size());
+
+    auto outputs = model.run_tiles(image_, bin, dirty, &t, cancel);
+    STAGE_TIMER(t.postprocess_ms);
+    for (size_t i = 0; i < dirty.size(); ++i)
+        patches[{dirty[i].x, dirty[i].y}] = outputs[i];
+
+    cv::Mat out = image_.clone();
+    if (!tiles.empty()) {
+        cv::Rect covered = tiles[0];
+        for (const auto &r: tiles) covered |= r;
+        TileBlender blender(covered, tile_size, overlap);
+        for (const auto &r: tiles) blender.add(r, patches.at({r.x, r.y}));
+        blender.composite(out, bin);
+    }
+    patches_ = std::move(patches);
+    return out;
+}
+
+cv::Mat EditSession::apply_components_(ModelSession &model, const cv::Mat &bin,
+                                       const cv::Mat &changed, StageTimings &t,
+                                       CancelToken *cancel) {
+    cv::Mat removed, dirty, out;
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        cv::bitwise_and(mask_, ~bin, removed);
+
+        // Components that grew, appeared or lost pixels: their fill depended on the old
+        // outline. Dilating reaches the components next to removed pixels.
+        cv::Mat touch;
+        cv::dilate(changed, touch, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3)));
+        dirty = touched_components_(bin, touch);
+
+        out = result_.clone();
+        image_.copyTo(out, removed);
+    }
+
+    const int dirty_px = cv::countNonZero(dirty);
+    LOGI("[EDIT] changed=%d px, recomputing %d of %d mask px",
+         cv::countNonZero(changed), dirty_px, cv::countNonZero(bin));
+    if (dirty_px > 0) {
+        // Context outside the dirty components is what the user sees: earlier fills included
+        auto outputs = model.run(out, dirty, &t, cancel);
+        if (outputs.empty()) throw std::runtime_error("no outputs from session");
+        STAGE_TIMER(t.postprocess_ms);
+        composite_roi(out, cv::Rect(0, 0, out.cols, out.rows), outputs[0], dirty);
+    }
+    return out;
+}
+
+std::vector<uint8_t> EditSession::apply(const std::vector<uint8_t> &maskBytes, StageTimings *timings,
+                                        CancelToken *cancel, const EncodeOptions &encoding) {
+    StageTimings local;
+    StageTimings &t = timings ? *timings : local;
+    cv::Mat mask;
+    {
+        STAGE_TIMER(t.decode_ms);
+        mask = decode(maskBytes, cv::IMREAD_GRAYSCALE);
+    }
+    cv::Mat out = apply(mask, &t, cancel);
+    STAGE_TIMER(t.encode_ms);
+    return encode_image(out, encoding);
+}
+
+cv::Mat EditSession::touched_components_(const cv::Mat &mask, const cv::Mat &changed) {
+    cv::Mat labels;
+    const int n = cv::connectedComponents(mask, labels, 8, CV_32S);
+    std::vector<uint8_t> keep(static_cast<size_t>(n), 0);
+    for (int y = 0; y < labels.rows; ++y) {
+        const int *l = labels.ptr<int>(y);
+        const uint8_t *c = changed.ptr<uint8_t>(y);
+        for (int x = 0; x < labels.cols; ++x)
+            if (c[x] && l[x]) keep[static_cast<size_t>(l[x])] = 255;
+    }
+
+    cv::Mat out(mask.size(), CV_8UC1);
+    for (int y = 0; y < labels.rows; ++y) {
+        const int *l = labels.ptr<int>(y);
+        uint8_t *o = out.ptr<uint8_t>(y);
+        for (int x = 0; x < labels.cols; ++x) o[x] = keep[static_cast<size_t>(l[x])];
+    }
+    return out;
+}
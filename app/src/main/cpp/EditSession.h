@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "config.h"
+#include "timing.h"
+
+class ModelPool;
+class ModelSession;
+class CancelToken;
+
+// Stroke-by-stroke editing of one image. Keeps the previous mask and result and, for each
+// new mask, recomputes only what the edit can have changed; pixels dropped from the mask
+// get the original image back.
+//  - With tiling (and an image at least the model size), the image is covered by a fixed
+//    grid of model-sized tiles and the previous per-tile outputs are kept. A tile whose mask
+//    crop did not change gives the same output, so only tiles the edit reaches are run.
+//  - Otherwise, the mask components the edit touched (grown, new, or shrunk) are run on
+//    the previous result, and every other region keeps its earlier output.
+// Each apply runs on a replica leased from the pool. Calls are serialized.
+class EditSession {
+public:
+    EditSession(std::shared_ptr<ModelPool> pool, cv::Mat image);
+
+    // Encoded image in, like runEndToEnd.
+    EditSession(std::shared_ptr<ModelPool> pool, const std::vector<uint8_t> &imageBytes);
+
+    // Result for the full new mask (any size; resized to the image). Throws RunCancelled when
+    // `cancel` fires, leaving the session at the previous mask.
+    cv::Mat apply(const cv::Mat &mask, StageTimings *timings = nullptr, CancelToken *cancel = nullptr);
+
+    // Encoded mask in, result encoded as `encoding` asks (PNG by default).
+    std::vector<uint8_t> apply(const std::vector<uint8_t> &maskBytes, StageTimings *timings = nullptr,
+                               CancelToken *cancel = nullptr, const EncodeOptions &encoding = {});
+
+    const cv::Mat &image() const { return image_; }
+
+    // Back to the unedited image and an empty mask.
+    void reset();
+
+private:
+    using TileKey = std::pair<int, int>; // tile origin (x, y)
+
+    // Tiled form of apply: rebuilds the result from kept and recomputed tile patches.
+    cv::Mat apply_tiled_(ModelSession &model, const cv::Mat &bin, const cv::Mat &changed,
+                         StageTimings &t, CancelToken *cancel);
+
+    // Component form of apply: reruns the touched components on the previous result.
+    cv::Mat apply_components_(ModelSession &model, const cv::Mat &bin, const cv::Mat &changed,
+                              StageTimings &t, CancelToken *cancel);
+
+    // Union of the 8-connected components of `mask` that overlap `changed`.
+    static cv::Mat touched_components_(const cv::Mat &mask, const cv::Mat &changed);
+
+    std::shared_ptr<ModelPool> pool_;
+    std::mutex m_;
+    cv::Mat image_;  // BGR
+    cv::Mat mask_;   // previous mask, binary {0, 255} at image size
+    cv::Mat result_; // previous output
+    std::map<TileKey, cv::Mat> patches_; // previous model output per tile (tiled form)
+};
@@ -1,11 +1,122 @@
 #include "InferenceRunner.h"
+#include "ModelPool.h"
 #include "ModelSession.h"
+#include "WeightSharing.h"
+#include "ResultCache.h"
+#include "MappedFile.h"
+#include "ModelCache.h"
+#include "hash.h"
+#include "logging.h"
 
-// TODO save optimized graph for fast load?
+#include <algorithm>
+#include <stdexcept>
 
-InferenceRunner::InferenceRunner()
-        : env_(ORT_LOGGING_LEVEL_VERBOSE, "cpponnxrunner") {
+InferenceRunner::InferenceRunner(RunnerOptions opts)
+        : topology_(CpuTopology::detect()),
+          options_(place_threads_(std::move(opts), topology_)),
+          env_(create_env_(options_.thread_pools)) {
+    LOGI("[TOPO] %s", topology_.describe().c_str());
     start_environment_();
+    scheduler_ = std::make_unique<Scheduler>(static_cast<size_t>(std::max(1, options_.scheduler.workers)),
+                                             options_.scheduler.queue_capacity,
+                                             placement_cpus_());
+}
+
+RunnerOptions InferenceRunner::place_threads_(RunnerOptions opts, const CpuTopology &topology) {
+    auto &tp = opts.thread_pools;
+    switch (opts.placement) {
+        case ThreadPlacement::Unpinned:
+            break;
+        case ThreadPlacement::PerCluster:
+            // One pool per cluster only works with per-session pools
+            if (tp.enabled) {
+                LOGI("[TOPO] per-cluster placement: global thread pools disabled");
+                tp.enabled = false;
+            }
+            break;
+        case ThreadPlacement::PerformanceCores:
+        case ThreadPlacement::AllCores: {
+            if (!tp.enabled) break;
+            const auto cpus = opts.placement == ThreadPlacement::AllCores
+                              ? topology.all_cpus() : topology.performance_cpus();
+            const int n = static_cast<int>(cpus.size());
+            if (tp.intra_op_threads <= 0 || tp.intra_op_threads > n) tp.intra_op_threads = n;
+            if (tp.intra_op_affinity.empty())
+                tp.intra_op_affinity = ort_thread_affinity(cpus, tp.intra_op_threads);
+            break;
+        }
+    }
+    return opts;
+}
+
+std::vector<int> InferenceRunner::placement_cpus_() const {
+    switch (options_.placement) {
+        case ThreadPlacement::AllCores:
+            return topology_.all_cpus();
+        case ThreadPlacement::PerformanceCores:
+        case ThreadPlacement::PerCluster: // callers' threads: pre/postprocessing, standalone sessions
+            return topology_.performance_cpus();
+        case ThreadPlacement::Unpinned:
+            break;
+    }
+    return {};
+}
+
+Ort::Env InferenceRunner::create_env_(const GlobalThreadPoolOptions &tp) {
+    if (!tp.enabled) return Ort::Env(ORT_LOGGING_LEVEL_VERBOSE, "cpponnxrunner");
+
+    Ort::ThreadingOptions threading;
+    threading.SetGlobalIntraOpNumThreads(tp.intra_op_threads);
+    threading.SetGlobalInterOpNumThreads(tp.inter_op_threads);
+    threading.SetGlobalSpinControl(tp.allow_spinning ? 1 : 0);
+    if (!tp.intra_op_affinity.empty()) {
+        if (tp.intra_op_threads <= 1)
+            throw std::invalid_argument("intra_op_affinity needs an explicit intra_op_threads > 1");
+        Ort::ThrowOnError(Ort::GetApi().SetGlobalIntraOpThreadAffinity(
+                threading, tp.intra_op_affinity.c_str()));
+    }
+    return Ort::Env(threading, ORT_LOGGING_LEVEL_VERBOSE, "cpponnxrunner");
+}
+
+RunnerSettings InferenceRunner::session_settings_(RunnerSettings s) const {
+    s.use_global_thread_pools = options_.thread_pools.enabled;
+    if (s.use_global_thread_pools || !s.intra_op_affinity.empty()) return s;
+
+    const auto cpus = placement_cpus_();
+    if (!cpus.empty()) {
+        s.num_cpu_cores = std::clamp(s.num_cpu_cores, 1, static_cast<int>(cpus.size()));
+        s.intra_op_affinity = ort_thread_affinity(cpus, s.num_cpu_cores);
+    }
+    return s;
+}
+
+std::vector<RunnerSettings>
+InferenceRunner::replica_settings_(const RunnerSettings &s, const int replicas) const {
+    std::vector<RunnerSettings> out;
+    if (options_.placement == ThreadPlacement::PerCluster) {
+        if (replicas != static_cast<int>(topology_.clusters().size()))
+            LOGI("[TOPO] per-cluster placement: %zu replicas instead of %d",
+                 topology_.clusters().size(), replicas);
+        for (const auto &cluster: topology_.clusters()) {
+            RunnerSettings rs = s;
+            rs.num_cpu_cores = static_cast<int>(cluster.cpus.size());
+            rs.intra_op_affinity = ort_thread_affinity(cluster.cpus, rs.num_cpu_cores);
+            out.push_back(session_settings_(std::move(rs)));
+        }
+        return out;
+    }
+    if (options_.thread_pools.enabled) {
+        // Replicas share the global pool; a split budget would be ignored by ORT anyway
+        LOGI("[POOL] %d replicas on the global pool of %d intra-op threads", replicas,
+             options_.thread_pools.intra_op_threads);
+        return std::vector<RunnerSettings>(static_cast<size_t>(replicas), session_settings_(s));
+    }
+    for (int threads: split_thread_budget(s.num_cpu_cores, replicas)) {
+        RunnerSettings rs = s;
+        rs.num_cpu_cores = threads;
+        out.push_back(session_settings_(std::move(rs)));
+    }
+    return out;
 }
 
 std::vector<std::shared_ptr<ModelSession>>
@@ -19,7 +130,10 @@ InferenceRunner::init_models(const std::vector<std::string> model_paths,
     std::vector<std::shared_ptr<ModelSession>> out;
     out.reserve(model_paths.size());
     for (const auto &p: model_paths) {
-        out.emplace_back(std::make_shared<ModelSession>(env_, mem_info_, s, p));
+        const auto sharing = shared_weights_(
+                static_cast<size_t>(std::count(model_paths.begin(), model_paths.end(), p)));
+        out.emplace_back(attach_(std::make_shared<ModelSession>(env_, mem_info_, session_settings_(s), p, sharing,
+                                                       model_hash(p, s.optimized_model_cache_dir))));
     }
     return out;
 }
@@ -29,9 +143,130 @@ InferenceRunner::init_model(const std::string model_path,
                             const RunnerSettings s) {
     if (model_path.empty()) throw std::invalid_argument("init_model: empty model_path");
     model_paths_.push_back(model_path);
-    return std::make_shared<ModelSession>(env_, mem_info_, s, model_path);
+    return attach_(std::make_shared<ModelSession>(env_, mem_info_, session_settings_(s), model_path, nullptr,
+                                                 model_hash(model_path, s.optimized_model_cache_dir)));
+}
+
+std::vector<std::shared_ptr<ModelSession>>
+InferenceRunner::init_models(const std::vector<std::shared_ptr<const MappedFile>> models,
+                             const RunnerSettings s) {
+    if (models.empty()) throw std::invalid_argument("init_models: empty models");
+
+    std::vector<std::shared_ptr<ModelSession>> out;
+    out.reserve(models.size());
+    for (const auto &m: models) {
+        const auto sharing = shared_weights_(static_cast<size_t>(std::count_if(
+                models.begin(), models.end(), [&](const auto &o) { return o->name() == m->name(); })));
+        out.emplace_back(attach_(std::make_shared<ModelSession>(env_, mem_info_, session_settings_(s), m, sharing,
+                                                       model_hash(*m, s.optimized_model_cache_dir))));
+        model_paths_.push_back(out.back()->model_path());
+    }
+    return out;
+}
+
+std::shared_ptr<ModelPool>
+InferenceRunner::init_pool(const std::string model_path, const RunnerSettings s, const int replicas) {
+    if (model_path.empty()) throw std::invalid_argument("init_pool: empty model_path");
+    model_paths_.push_back(model_path);
+
+    const uint64_t hash = model_hash(model_path, s.optimized_model_cache_dir);
+    const auto settings = replica_settings_(s, replicas);
+    const auto sharing = shared_weights_(settings.size());
+    std::vector<std::shared_ptr<ModelSession>> sessions;
+    for (const RunnerSettings &rs: settings) {
+        sessions.emplace_back(attach_(std::make_shared<ModelSession>(env_, mem_info_, rs, model_path, sharing, hash)));
+    }
+    return std::make_shared<ModelPool>(std::move(sessions));
+}
+
+std::shared_ptr<ModelPool>
+InferenceRunner::init_pool(const std::shared_ptr<const MappedFile> model, const RunnerSettings s,
+                           const int replicas) {
+    if (!model) throw std::invalid_argument("init_pool: null model");
+    model_paths_.push_back(model->name());
+
+    const uint64_t hash = model_hash(*model, s.optimized_model_cache_dir);
+    const auto settings = replica_settings_(s, replicas);
+    const auto sharing = shared_weights_(settings.size());
+    std::vector<std::shared_ptr<ModelSession>> sessions;
+    for (const RunnerSettings &rs: settings) {
+        sessions.emplace_back(attach_(std::make_shared<ModelSession>(env_, mem_info_, rs, model, sharing, hash)));
+    }
+    return std::make_shared<ModelPool>(std::move(sessions));
+}
+
+std::future<std::vector<uint8_t>>
+InferenceRunner::submit(std::shared_ptr<ModelSession> model,
+                        std::vector<uint8_t> imageBytes,
+                        std::vector<uint8_t> maskBytes,
+                        std::optional<EncodeOptions> encoding) {
+    if (!model) throw std::invalid_argument("submit: null model");
+    return scheduler_->submit(
+            [model = std::move(model), img = std::move(imageBytes), mask = std::move(maskBytes),
+             encoding = std::move(encoding)] {
+                return model->runEndToEnd(img, mask, nullptr, encoding ? &*encoding : nullptr);
+            });
+}
+
+std::future<std::vector<uint8_t>>
+InferenceRunner::submit(std::shared_ptr<ModelPool> pool,
+                        std::vector<uint8_t> imageBytes,
+                        std::vector<uint8_t> maskBytes,
+                        std::optional<EncodeOptions> encoding) {
+    if (!pool) throw std::invalid_argument("submit: null pool");
+    return scheduler_->submit(
+            [pool = std::move(pool), img = std::move(imageBytes), mask = std::move(maskBytes),
+             encoding = std::move(encoding)] {
+                return pool->runEndToEnd(img, mask, nullptr, encoding ? &*encoding : nullptr);
+            });
+}
+
+std::shared_ptr<WeightSharing> InferenceRunner::shared_weights_(const size_t sessions) const {
+    // A model file loaded by a single session gains nothing from sharing
+    return sessions > 1 ? sharing_ : nullptr;
 }
 
 void InferenceRunner::start_environment_() {
     mem_info_ = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+    sharing_ = std::make_shared<WeightSharing>();
+    configure_result_cache(options_.result_cache);
+}
+
+void InferenceRunner::configure_result_cache(const ResultCacheOptions &opts) {
+    options_.result_cache = opts;
+    result_cache_ = opts.enabled ? std::make_shared<ResultCache>(opts) : nullptr;
+}
+
+uint64_t InferenceRunner::model_hash(const std::string &model_path, const std::string &dir) {
+    std::string id = file_identity(model_path);
+    if (id.empty()) return model_content_hash(model_path, dir);
+    id += "|" + model_path;
+    {
+        std::lock_guard<std::mutex> lk(model_hashes_m_);
+        auto it = model_hashes_.find(id);
+        if (it != model_hashes_.end()) return it->second;
+    }
+    const uint64_t h = model_content_hash(model_path, dir);
+    std::lock_guard<std::mutex> lk(model_hashes_m_);
+    model_hashes_[id] = h;
+    return h;
+}
+
+uint64_t InferenceRunner::model_hash(const MappedFile &model, const std::string &dir) {
+    if (model.identity().empty()) return model_content_hash(model, dir);
+    const std::string id = model.identity() + "|" + model.name();
+    {
+        std::lock_guard<std::mutex> lk(model_hashes_m_);
+        auto it = model_hashes_.find(id);
+        if (it != model_hashes_.end()) return it->second;
+    }
+    const uint64_t h = model_content_hash(model, dir);
+    std::lock_guard<std::mutex> lk(model_hashes_m_);
+    model_hashes_[id] = h;
+    return h;
+}
+
+std::shared_ptr<ModelSession> InferenceRunner::attach_(std::shared_ptr<ModelSession> session) const {
+    if (result_cache_) session->set_result_cache(result_cache_);
+    return session;
 }
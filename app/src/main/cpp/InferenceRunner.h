@@ -3,7 +3,11 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 
 #include <onnxruntime_cxx_api.h>
@@ -12,24 +16,100 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 #include <nnapi_provider_factory.h>
-#include <android/log.h>
 #include <onnxruntime_session_options_config_keys.h>
 #include "config.h"
+#include "CpuTopology.h"
+#include "Scheduler.h"
 
 class ModelSession;
+class WeightSharing;
+class MappedFile;
+class ModelPool;
+class ResultCache;
 
 class InferenceRunner {
 public:
-    InferenceRunner();
+    explicit InferenceRunner(RunnerOptions opts = {});
 
     // Provide the model path and configure internal settings
     std::vector<std::shared_ptr<ModelSession>> init_models(std::vector<std::string> model_paths, RunnerSettings s);
     std::shared_ptr<ModelSession> init_model(std::string model_path, RunnerSettings s);
 
+    // Same, for models the caller has already mapped (APK assets)
+    std::vector<std::shared_ptr<ModelSession>> init_models(std::vector<std::shared_ptr<const MappedFile>> models, RunnerSettings s);
+
+    // `replicas` sessions of one model sharing its weights; s.num_cpu_cores is split
+    // between them (see split_thread_budget). With ThreadPlacement::PerCluster there is
+    // one replica per CPU cluster instead, each pinned to its cluster. With global thread
+    // pools there is nothing to split: every replica runs on the Env's one intra-op pool,
+    // sized by RunnerOptions::thread_pools.
+    std::shared_ptr<ModelPool> init_pool(std::string model_path, RunnerSettings s, int replicas);
+    std::shared_ptr<ModelPool> init_pool(std::shared_ptr<const MappedFile> model, RunnerSettings s, int replicas);
+
+    // Queue an end-to-end request on the runner's worker pool; blocks while the queue is full.
+    // `encoding` overrides the model's RunnerSettings::encoding for this request.
+    std::future<std::vector<uint8_t>> submit(std::shared_ptr<ModelSession> model,
+                                             std::vector<uint8_t> imageBytes,
+                                             std::vector<uint8_t> maskBytes,
+                                             std::optional<EncodeOptions> encoding = std::nullopt);
+    std::future<std::vector<uint8_t>> submit(std::shared_ptr<ModelPool> pool,
+                                             std::vector<uint8_t> imageBytes,
+                                             std::vector<uint8_t> maskBytes,
+                                             std::optional<EncodeOptions> encoding = std::nullopt);
+
+    Scheduler &scheduler() { return *scheduler_; }
+
+    const CpuTopology &topology() const { return topology_; }
+
+    // Sessions run on the Env's global pools (RunnerSettings::use_global_thread_pools).
+    bool global_thread_pools() const { return options_.thread_pools.enabled; }
+
+    // Replaces the result cache (RunnerOptions::result_cache) for models created afterwards,
+    // e.g. once the app knows its cache directory.
+    void configure_result_cache(const ResultCacheOptions &opts);
+
+    // Null when disabled.
+    const std::shared_ptr<ResultCache> &result_cache() const { return result_cache_; }
+
+    // Content hash of a model (model_content_hash with sidecars in `dir`), remembered per
+    // file version for the runner's lifetime: every replica and tuner trial reuses it.
+    uint64_t model_hash(const std::string &model_path, const std::string &dir = {});
+    uint64_t model_hash(const MappedFile &model, const std::string &dir = {});
+
 private:
     void start_environment_();
 
+    // Weight sharing for a model file loaded by `sessions` sessions; null unless there are several.
+    std::shared_ptr<WeightSharing> shared_weights_(size_t sessions) const;
+
+    static Ort::Env create_env_(const GlobalThreadPoolOptions &tp);
+
+    // Resolves opts.placement against the topology into thread counts and affinities.
+    static RunnerOptions place_threads_(RunnerOptions opts, const CpuTopology &topology);
+
+    // Cores the placement keeps sessions and workers on; empty when unpinned.
+    std::vector<int> placement_cpus_() const;
+
+    // Per-model settings adjusted to this runner (global thread pools, placement).
+    RunnerSettings session_settings_(RunnerSettings s) const;
+
+    // Hooks a new session up to the runner's result cache.
+    std::shared_ptr<ModelSession> attach_(std::shared_ptr<ModelSession> session) const;
+
+    // Settings of each replica of a pool
+    std::vector<RunnerSettings> replica_settings_(const RunnerSettings &s, int replicas) const;
+
+    CpuTopology topology_;
+    RunnerOptions options_;
     std::vector<std::string> model_paths_;
     Ort::MemoryInfo mem_info_{nullptr};
     Ort::Env env_;
+    std::shared_ptr<WeightSharing> sharing_;
+    std::shared_ptr<ResultCache> result_cache_;
+
+    std::mutex model_hashes_m_;
+    std::map<std::string, uint64_t> model_hashes_; // by file identity
+
+    // Last member: destroyed first, so queued requests finish while the env is alive
+    std::unique_ptr<Scheduler> scheduler_;
 };
@@ -0,0 +1,71 @@
+#include "MappedFile.h"
+#include "hash.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::string errno_text() { return std::strerror(errno); }
+
+} // namespace
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("MappedFile: cannot open " + path + ": " + errno_text());
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        const std::string err = errno_text();
+        ::close(fd);
+        throw std::runtime_error("MappedFile: cannot stat " + path + ": " + err);
+    }
+    try {
+        auto mapped = map(fd, 0, static_cast<size_t>(st.st_size), path);
+        ::close(fd);
+        return mapped;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+std::shared_ptr<const MappedFile> MappedFile::map(int fd, off_t offset, size_t length,
+                                                  std::string name) {
+    return std::shared_ptr<const MappedFile>(new MappedFile(fd, offset, length, std::move(name)));
+}
+
+MappedFile::MappedFile(int fd, off_t offset, size_t length, std::string name)
+        : name_(std::move(name)) {
+    if (length == 0) throw std::runtime_error("MappedFile: empty " + name_);
+
+    // mmap offsets must be page aligned; APK assets usually are not
+    const off_t page = static_cast<off_t>(::sysconf(_SC_PAGESIZE));
+    const off_t aligned = offset - offset % page;
+    const size_t lead = static_cast<size_t>(offset - aligned);
+
+    base_size_ = length + lead;
+    base_ = ::mmap(nullptr, base_size_, PROT_READ, MAP_PRIVATE, fd, aligned);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        throw std::runtime_error("MappedFile: cannot map " + name_ + ": " + errno_text());
+    }
+    // Session creation parses the model front to back
+    ::madvise(base_, base_size_, MADV_SEQUENTIAL);
+
+    data_ = static_cast<const uint8_t *>(base_) + lead;
+    size_ = length;
+
+    identity_ = file_identity(fd);
+    if (!identity_.empty())
+        identity_ += "@" + std::to_string(offset) + "+" + std::to_string(length);
+}
+
+MappedFile::~MappedFile() {
+    if (base_) ::munmap(base_, base_size_);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+// Read-only memory mapping of a whole file or of a byte range inside one (an
+// uncompressed APK asset). Pages are loaded on demand and are clean, so the kernel
+// can drop them under pressure instead of the process holding a heap copy.
+class MappedFile {
+public:
+    // Maps `path` entirely. Throws std::runtime_error on failure.
+    static std::shared_ptr<const MappedFile> open(const std::string &path);
+
+    // Maps [offset, offset + length) of `fd`; `name` identifies the model (cache keys,
+    // logs). The descriptor is not kept and may be closed afterwards.
+    static std::shared_ptr<const MappedFile> map(int fd, off_t offset, size_t length,
+                                                 std::string name);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    const std::string &name() const { return name_; }
+
+    // Cheap version stamp of the mapped bytes: device, inode, size and mtime of the
+    // underlying file plus the range. Changes whenever the file is replaced (app update).
+    const std::string &identity() const { return identity_; }
+
+private:
+    MappedFile(int fd, off_t offset, size_t length, std::string name);
+
+    void *base_ = nullptr;
+    size_t base_size_ = 0;
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    std::string name_;
+    std::string identity_;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Collects items submitted concurrently and hands them to `flush` in groups: a group
+// closes when it reaches `max_batch` items or `window` after its first item arrived,
+// whichever comes first. `flush` runs on the batcher's own thread, one group at a time,
+// and must complete every item (items typically carry a promise the submitter waits on).
+template<typename Item>
+class MicroBatcher {
+public:
+    using Flush = std::function<void(std::vector<Item> &)>;
+
+    MicroBatcher(size_t max_batch, std::chrono::microseconds window, Flush flush)
+            : max_batch_(max_batch ? max_batch : 1), window_(window), flush_(std::move(flush)),
+              thread_([this] { loop_(); }) {}
+
+    // Flushes what is pending, then stops.
+    ~MicroBatcher() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    MicroBatcher(const MicroBatcher &) = delete;
+    MicroBatcher &operator=(const MicroBatcher &) = delete;
+
+    void submit(Item item) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            pending_.push_back(std::move(item));
+        }
+        cv_.notify_all();
+    }
+
+private:
+    void loop_() {
+        std::vector<Item> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                cv_.wait(lk, [&] { return stop_ || !pending_.empty(); });
+                if (pending_.empty()) return; // stopping
+                const auto deadline = std::chrono::steady_clock::now() + window_;
+                cv_.wait_until(lk, deadline, [&] { return stop_ || pending_.size() >= max_batch_; });
+
+                const size_t n = std::min(pending_.size(), max_batch_);
+                batch.clear();
+                for (size_t i = 0; i < n; ++i) batch.push_back(std::move(pending_[i]));
+                pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(n));
+            }
+            flush_(batch);
+        }
+    }
+
+    const size_t max_batch_;
+    const std::chrono::microseconds window_;
+    const Flush flush_;
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<Item> pending_;
+    bool stop_ = false;
+
+    std::thread thread_; // last: starts after the members above are initialized
+};
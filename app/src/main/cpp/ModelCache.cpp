@@ -0,0 +1,122 @@
+#include "ModelCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+
+#include <onnxruntime_cxx_api.h>
+#include "MappedFile.h"
+#include "hash.h"
+#include "logging.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+uint64_t memoized_hash(const std::string &model_name, const std::string &identity,
+                       const std::string &dir, const std::function<uint64_t()> &compute) {
+    if (dir.empty() || identity.empty()) return compute();
+
+    const std::string name = fs::path(model_name).filename().string();
+    const std::string sidecar =
+            (fs::path(dir) / (name + "." + hash_to_hex(hash_bytes(identity.data(), identity.size())) +
+                              ".hash")).string();
+    if (FILE *f = std::fopen(sidecar.c_str(), "rb")) {
+        unsigned long long h = 0;
+        const bool ok = std::fscanf(f, "%16llx", &h) == 1;
+        std::fclose(f);
+        if (ok) return h;
+    }
+
+    const uint64_t h = compute();
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    // Sidecars of earlier versions of this model are stale now
+    const std::string prefix = name + ".";
+    for (const auto &e: fs::directory_iterator(dir, ec)) {
+        const std::string n = e.path().filename().string();
+        if (n.compare(0, prefix.size(), prefix) == 0 && e.path().extension() == ".hash") {
+            std::error_code rm_ec;
+            fs::remove(e.path(), rm_ec);
+        }
+    }
+    const std::string tmp = sidecar + ".tmp";
+    if (FILE *f = std::fopen(tmp.c_str(), "wb")) {
+        const std::string hex = hash_to_hex(h);
+        const bool ok = std::fwrite(hex.data(), 1, hex.size(), f) == hex.size();
+        if (std::fclose(f) == 0 && ok) fs::rename(tmp, sidecar, ec);
+        else fs::remove(tmp, ec);
+    }
+    LOGI("[CACHE] hashed %s: %s", name.c_str(), hash_to_hex(h).c_str());
+    return h;
+}
+
+} // namespace
+
+uint64_t model_content_hash(const std::string &model_path, const std::string &dir) {
+    return memoized_hash(model_path, file_identity(model_path), dir,
+                         [&] { return hash_file(model_path); });
+}
+
+uint64_t model_content_hash(const MappedFile &model, const std::string &dir) {
+    return memoized_hash(model.name(), model.identity(), dir,
+                         [&] { return hash_content(model.data(), model.size()); });
+}
+
+std::string optimization_fingerprint(const RunnerSettings &s) {
+    // Thread counts do not change the graph; leaving them out lets pool replicas with
+    // different thread budgets share one entry.
+    std::string f;
+    f += "xnnpack=" + std::to_string(s.use_xnnpack);
+    f += ";xnnpack_session_threads=" + std::to_string(s.xnnpack.use_session_threads);
+    f += ";nnapi=" + std::to_string(s.use_nnapi);
+    f += ";nnapi_flags=" + std::to_string(NnapiOptions::to_raw(s.nnapi.flags));
+    f += ";parallel=" + std::to_string(s.use_parallel_execution);
+    f += ";layout=" + std::to_string(s.use_layout_optimization_instead_of_extended);
+    return f;
+}
+
+OptimizedModelCache::OptimizedModelCache(std::string dir, const std::string &model_name,
+                                         uint64_t model_hash, const RunnerSettings &s)
+        : dir_(std::move(dir)),
+          model_name_(fs::path(model_name).filename().string()) {
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    const std::string meta = optimization_fingerprint(s) + ";ort=" + Ort::GetVersionString();
+    const uint64_t key = hash_combine(model_hash, hash_bytes(meta.data(), meta.size()));
+    entry_path_ = (fs::path(dir_) / (model_name_ + "." + hash_to_hex(key) + ".opt.onnx")).string();
+    staging_path_ = entry_path_ + ".tmp";
+}
+
+bool OptimizedModelCache::has_entry() const {
+    std::error_code ec;
+    return fs::is_regular_file(entry_path_, ec) && fs::file_size(entry_path_, ec) > 0;
+}
+
+void OptimizedModelCache::commit() {
+    std::error_code ec;
+    fs::rename(staging_path_, entry_path_, ec);
+    if (ec) {
+        LOGE("[CACHE] cannot publish %s: %s", entry_path_.c_str(), ec.message().c_str());
+        return;
+    }
+    // Invalidate entries for the same model built under another key
+    const std::string prefix = model_name_ + ".";
+    const std::string entry_name = fs::path(entry_path_).filename().string();
+    for (const auto &e: fs::directory_iterator(dir_, ec)) {
+        const std::string name = e.path().filename().string();
+        if (name != entry_name && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.find(".opt.onnx") != std::string::npos) {
+            std::error_code rm_ec;
+            fs::remove(e.path(), rm_ec);
+            LOGI("[CACHE] removed stale %s", name.c_str());
+        }
+    }
+}
+
+void OptimizedModelCache::discard() {
+    std::error_code ec;
+    fs::remove(staging_path_, ec);
+    fs::remove(entry_path_, ec);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "config.h"
+
+// On-disk cache of ORT-optimized model graphs.
+//
+// An entry is `<dir>/<model file name>.<key>.opt.onnx` where key hashes the model
+// contents, the RunnerSettings fields that affect optimization and the ORT version,
+// so changing any of them simply misses and replaces the previous entry.
+class OptimizedModelCache {
+public:
+    // `model_hash` is the model's content hash (model_content_hash()).
+    OptimizedModelCache(std::string dir, const std::string &model_name, uint64_t model_hash,
+                        const RunnerSettings &s);
+
+    bool has_entry() const;
+
+    const std::string &entry_path() const { return entry_path_; }
+
+    // Where ORT should write the optimized graph before commit().
+    const std::string &staging_path() const { return staging_path_; }
+
+    // Publish the staged graph and drop entries of this model with other keys.
+    void commit();
+
+    // Remove the entry and any staged file (e.g. the cached graph failed to load).
+    void discard();
+
+private:
+    std::string dir_;
+    std::string model_name_;
+    std::string entry_path_;
+    std::string staging_path_;
+};
+
+// Settings that change the optimized graph, as a stable string.
+std::string optimization_fingerprint(const RunnerSettings &s);
+
+class MappedFile;
+
+// Content hash of a model (hash_file / hash_content), memoized in a small sidecar file in
+// `dir` (`<model file name>.<identity key>.hash`) under the file's identity, so a model of
+// hundreds of MB is read in full once per version instead of on every cold start. Without
+// a dir, or without an identity, it is simply computed.
+uint64_t model_content_hash(const std::string &model_path, const std::string &dir);
+uint64_t model_content_hash(const MappedFile &model, const std::string &dir);
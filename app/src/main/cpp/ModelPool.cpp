@@ -0,0 +1,100 @@
+#include "ModelPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ModelSession.h"
+
+ModelPool::ModelPool(std::vector<std::shared_ptr<ModelSession>> replicas)
+        : replicas_(std::move(replicas)) {
+    if (replicas_.empty()) throw std::invalid_argument("ModelPool: no replicas");
+    for (const auto &r: replicas_)
+        if (!r) throw std::invalid_argument("ModelPool: null replica");
+    in_flight_.assign(replicas_.size(), 0);
+}
+
+ModelPool::Lease ModelPool::acquire() {
+    std::lock_guard<std::mutex> lk(m_);
+    const size_t n = replicas_.size();
+    size_t best = next_ % n;
+    for (size_t k = 1; k < n; ++k) {
+        const size_t i = (next_ + k) % n;
+        if (in_flight_[i] < in_flight_[best]) best = i;
+    }
+    next_ = best + 1;
+    ++in_flight_[best];
+    return Lease(this, best, replicas_[best]);
+}
+
+std::vector<uint8_t> ModelPool::runEndToEnd(const std::vector<uint8_t> &imageBytes,
+                                            const std::vector<uint8_t> &maskBytes,
+                                            StageTimings *timings,
+                                            const EncodeOptions *encoding) {
+    return runEndToEnd(imageBytes.data(), imageBytes.size(), maskBytes.data(), maskBytes.size(),
+                       timings, encoding);
+}
+
+std::vector<uint8_t> ModelPool::runEndToEnd(const uint8_t *imageData, size_t imageSize,
+                                            const uint8_t *maskData, size_t maskSize,
+                                            StageTimings *timings,
+                                            const EncodeOptions *encoding) {
+    StageTimings t;
+    std::vector<uint8_t> out = acquire()->runEndToEnd(imageData, imageSize, maskData, maskSize, &t,
+                                                      encoding);
+    if (!t.cache_hit) profiler_.record(t);
+    if (timings) *timings = t;
+    return out;
+}
+
+cv::Mat ModelPool::runImage(const cv::Mat &image, const cv::Mat &mask, StageTimings *timings) {
+    StageTimings t;
+    cv::Mat out = acquire()->runImage(image, mask, &t);
+    profiler_.record(t);
+    if (timings) *timings = t;
+    return out;
+}
+
+std::vector<uint8_t> ModelPool::runProgressive(
+        const std::vector<uint8_t> &imageBytes,
+        const std::vector<uint8_t> &maskBytes,
+        const std::function<void(const std::vector<uint8_t> &)> &on_preview,
+        CancelToken *cancel,
+        StageTimings *timings,
+        const EncodeOptions *encoding) {
+    StageTimings t;
+    std::vector<uint8_t> out = acquire()->runProgressive(imageBytes, maskBytes, on_preview, cancel, &t,
+                                                                encoding);
+    if (!out.empty() && !t.cache_hit) profiler_.record(t);
+    if (timings) *timings = t;
+    return out;
+}
+
+std::vector<size_t> ModelPool::in_flight() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return in_flight_;
+}
+
+void ModelPool::release_(size_t index) {
+    std::lock_guard<std::mutex> lk(m_);
+    --in_flight_[index];
+}
+
+ModelPool::Lease::Lease(ModelPool *pool, size_t index, std::shared_ptr<ModelSession> session)
+        : pool_(pool), index_(index), session_(std::move(session)) {}
+
+ModelPool::Lease::Lease(Lease &&other) noexcept
+        : pool_(other.pool_), index_(other.index_), session_(std::move(other.session_)) {
+    other.pool_ = nullptr;
+}
+
+ModelPool::Lease::~Lease() {
+    if (pool_) pool_->release_(index_);
+}
+
+std::vector<int> split_thread_budget(int cores, int replicas) {
+    if (replicas <= 0) throw std::invalid_argument("split_thread_budget: replicas must be > 0");
+    cores = std::max(cores, replicas);
+    std::vector<int> budget(static_cast<size_t>(replicas), cores / replicas);
+    for (int i = 0; i < cores % replicas; ++i) ++budget[static_cast<size_t>(i)];
+    return budget;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "config.h"
+#include "profiler.h"
+#include "timing.h"
+
+class ModelSession;
+class CancelToken;
+
+// Interchangeable replicas of one model. Each request goes to the replica with the fewest
+// requests in flight (ties rotate), so concurrent callers spread over the replicas instead
+// of contending for one session's intra-op thread pool.
+class ModelPool {
+public:
+    explicit ModelPool(std::vector<std::shared_ptr<ModelSession>> replicas);
+
+    // Exclusive-ish use of one replica; counts as in flight until destroyed.
+    class Lease {
+    public:
+        Lease(Lease &&other) noexcept;
+        ~Lease();
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+
+        ModelSession &operator*() const { return *session_; }
+
+        ModelSession *operator->() const { return session_.get(); }
+
+        size_t index() const { return index_; }
+
+    private:
+        friend class ModelPool;
+
+        Lease(ModelPool *pool, size_t index, std::shared_ptr<ModelSession> session);
+
+        ModelPool *pool_;
+        size_t index_;
+        std::shared_ptr<ModelSession> session_;
+    };
+
+    Lease acquire();
+
+    std::vector<uint8_t> runEndToEnd(const std::vector<uint8_t> &imageBytes,
+                                     const std::vector<uint8_t> &maskBytes,
+                                     StageTimings *timings = nullptr,
+                                     const EncodeOptions *encoding = nullptr);
+
+    std::vector<uint8_t> runEndToEnd(const uint8_t *imageData, size_t imageSize,
+                                     const uint8_t *maskData, size_t maskSize,
+                                     StageTimings *timings = nullptr,
+                                     const EncodeOptions *encoding = nullptr);
+
+    // ModelSession::runImage on one replica.
+    cv::Mat runImage(const cv::Mat &image, const cv::Mat &mask, StageTimings *timings = nullptr);
+
+    // ModelSession::runProgressive on one replica.
+    std::vector<uint8_t> runProgressive(const std::vector<uint8_t> &imageBytes,
+                                        const std::vector<uint8_t> &maskBytes,
+                                        const std::function<void(const std::vector<uint8_t> &)> &on_preview,
+                                        CancelToken *cancel = nullptr,
+                                        StageTimings *timings = nullptr,
+                                        const EncodeOptions *encoding = nullptr);
+
+    size_t size() const { return replicas_.size(); }
+
+    const std::shared_ptr<ModelSession> &replica(size_t i) const { return replicas_.at(i); }
+
+    // Requests currently running on each replica.
+    std::vector<size_t> in_flight() const;
+
+    // Stage timings over the pool's recent requests, whichever replica served them.
+    StageStats stage_stats() const { return profiler_.stats(); }
+
+    void reset_stage_stats() { profiler_.reset(); }
+
+private:
+    void release_(size_t index);
+
+    std::vector<std::shared_ptr<ModelSession>> replicas_;
+
+    mutable std::mutex m_;
+    std::vector<size_t> in_flight_;
+    size_t next_ = 0;
+
+    StageProfiler profiler_;
+};
+
+// Splits `cores` intra-op threads over `replicas` sessions: the budgets differ by at most
+// one and sum to max(cores, replicas), since every replica needs at least one thread.
+// Only meaningful for per-session pools; global pools ignore per-session thread counts.
+std::vector<int> split_thread_budget(int cores, int replicas);
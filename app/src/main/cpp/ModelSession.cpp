@@ -1,50 +1,384 @@
 #include "ModelSession.h"
 #include "logging.h"
+#include "ModelCache.h"
+#include "postprocess.h"
+#include "preprocess.h"
+#include "roi.h"
+#include "tiling.h"
+#include "WeightSharing.h"
+#include "ResultCache.h"
+#include "decode.h"
+#include "encode.h"
+#include "hash.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <mutex>
 
 /*
  * https://github.com/devingarg/onnx-quantization/blob/main/resnet_inference.cpp
  */
 
+namespace {
+
+// ORT format files are flatbuffers with the "ORTM" file identifier.
+bool is_ort_format(const MappedFile &model) {
+    return model.size() >= 8 && std::memcmp(model.data() + 4, "ORTM", 4) == 0;
+}
+
+// From the mapped bytes when given, else from `path`. External data of a mapped ONNX
+// file is still looked up next to it (assets have relative names and none).
+Ort::Session new_session(Ort::Env &env, const std::string &path, const MappedFile *bytes,
+                         Ort::SessionOptions &so, OrtPrepackedWeightsContainer *prepacked) {
+    if (!bytes) {
+        return prepacked ? Ort::Session(env, path.c_str(), so, prepacked)
+                         : Ort::Session(env, path.c_str(), so);
+    }
+    const std::filesystem::path file(path);
+    if (file.is_absolute()) {
+        so.AddConfigEntry(kOrtSessionOptionsModelExternalInitializersFileFolderPath,
+                          file.parent_path().string().c_str());
+    }
+    return prepacked ? Ort::Session(env, bytes->data(), bytes->size(), so, prepacked)
+                     : Ort::Session(env, bytes->data(), bytes->size(), so);
+}
+
+// Input/output element types the pre/postprocessing kernels handle.
+bool is_supported_type(ONNXTensorElementDataType t) {
+    return t == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT || t == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
+}
+
+size_t element_bytes(ONNXTensorElementDataType t) {
+    return t == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 ? sizeof(uint16_t) : sizeof(float);
+}
+
+// Graph optimization level the settings ask for (see init_session).
+GraphOptimizationLevel optimization_level(const RunnerSettings &s) {
+    if (s.use_nnapi) return ORT_ENABLE_BASIC;
+    return s.use_layout_optimization_instead_of_extended ? ORT_ENABLE_ALL : ORT_ENABLE_EXTENDED;
+}
+
+} // namespace
+
 ModelSession::ModelSession(Ort::Env &env,
                            Ort::MemoryInfo &mem_info,
                            RunnerSettings s,
-                           std::string model_path)
-        : mem_info_(mem_info) {
+                           std::string model_path,
+                           std::shared_ptr<WeightSharing> sharing,
+                           uint64_t model_hash)
+        : sharing_(s.share_weights ? std::move(sharing) : nullptr), mem_info_(mem_info),
+          model_hash_(model_hash) {
     model_path_ = model_path;
     settings_ = s;
 
-    Ort::SessionOptions so = init_session(s);
-    session_ = Ort::Session(env, model_path_.c_str(), so);
+    create_session_(env, s);
 
     find_input_output_info_();
+    free_slots_.push_back(make_slot_());
+    start_batcher_();
+    start_tile_workers_();
 }
 
+ModelSession::ModelSession(Ort::Env &env,
+                           Ort::MemoryInfo &mem_info,
+                           RunnerSettings s,
+                           std::shared_ptr<const MappedFile> model,
+                           std::shared_ptr<WeightSharing> sharing,
+                           uint64_t model_hash)
+        : sharing_(s.share_weights ? std::move(sharing) : nullptr), mem_info_(mem_info),
+          model_hash_(model_hash) {
+    if (!model) throw std::invalid_argument("ModelSession: null model");
+    model_file_ = std::move(model);
+    model_path_ = model_file_->name();
+    settings_ = s;
+
+    create_session_(env, s);
+
+    find_input_output_info_();
+    free_slots_.push_back(make_slot_());
+    start_batcher_();
+    start_tile_workers_();
+}
+
+void ModelSession::create_session_(Ort::Env &env, const RunnerSettings &s) {
+    if (s.optimized_model_cache_dir.empty()) {
+        open_session_(env, model_path_, init_session(s));
+        return;
+    }
+
+    // EP partitioned/compiled graphs are device specific and may not serialize, so with
+    // XNNPACK/NNAPI only the hardware-independent BASIC level is cached. Shared
+    // initializers are external to the graph, so those sessions also use a plain writer.
+    const bool has_eps = s.use_xnnpack || s.use_nnapi;
+    const bool separate_writer = has_eps || sharing_;
+    OptimizedModelCache cache(s.optimized_model_cache_dir, model_path_, content_hash_(), s);
+
+    if (cache.has_entry()) {
+        try {
+            Ort::SessionOptions so = init_session(s);
+            if (!has_eps) so.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+            open_session_(env, cache.entry_path(), std::move(so));
+            LOGI("[CACHE] loaded optimized graph %s", cache.entry_path().c_str());
+            return;
+        } catch (const Ort::Exception &e) {
+            LOGE("[CACHE] cached graph unusable, rebuilding: %s", e.what());
+            cache.discard();
+        }
+    }
+
+    try {
+        if (separate_writer) {
+            {
+                // Same level as the cache key records; released before the real session loads
+                Ort::SessionOptions basic;
+                basic.SetGraphOptimizationLevel(has_eps ? ORT_ENABLE_BASIC : optimization_level(s));
+                basic.SetOptimizedModelFilePath(cache.staging_path().c_str());
+                const auto bytes = model_bytes_(model_path_);
+                Ort::Session writer = new_session(env, model_path_, bytes.get(), basic, nullptr);
+            }
+            cache.commit();
+            Ort::SessionOptions so = init_session(s);
+            if (!has_eps) so.SetGraphOptimizationLevel(ORT_DISABLE_ALL);
+            open_session_(env, cache.entry_path(), std::move(so));
+        } else {
+            Ort::SessionOptions so = init_session(s);
+            so.SetOptimizedModelFilePath(cache.staging_path().c_str());
+            open_session_(env, model_path_, std::move(so));
+            cache.commit();
+        }
+        LOGI("[CACHE] saved optimized graph %s", cache.entry_path().c_str());
+    } catch (const Ort::Exception &e) {
+        LOGE("[CACHE] cannot cache optimized graph: %s", e.what());
+        cache.discard();
+        open_session_(env, model_path_, init_session(s));
+    }
+}
+
+void ModelSession::open_session_(Ort::Env &env, const std::string &path, Ort::SessionOptions so) {
+    auto bytes = model_bytes_(path);
+
+    // ORT-format models can run on the mapped flatbuffer, initializers included, without
+    // copying it; ORT then requires the bytes to outlive the session.
+    const bool in_place = bytes && settings_.load.use_model_bytes_directly && is_ort_format(*bytes);
+    if (in_place) {
+        so.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+        so.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesForInitializers, "1");
+    }
+
+    OrtPrepackedWeightsContainer *prepacked = nullptr;
+    if (sharing_) {
+        // Initializer names follow the file actually loaded (a cached graph renames fused ones)
+        shared_initializers_ = sharing_->initializers_for(bytes);
+        shared_initializers_->add_to(so);
+        prepacked = sharing_->prepacked();
+    }
+    session_ = new_session(env, path, bytes.get(), so, prepacked);
+    session_bytes_ = in_place ? std::move(bytes) : nullptr;
+}
+
+std::shared_ptr<const MappedFile> ModelSession::model_bytes_(const std::string &path) const {
+    if (model_file_ && path == model_path_) return model_file_;
+    // Shared initializers are parsed from the mapping even when sessions load by path
+    if (settings_.load.memory_map || sharing_) return MappedFile::open(path);
+    return nullptr;
+}
 
 std::vector<uint8_t> ModelSession::runEndToEnd(const std::vector<uint8_t> &imageBytes,
-                                               const std::vector<uint8_t> &maskBytes) {
-    if (imageBytes.empty())
+                                               const std::vector<uint8_t> &maskBytes,
+                                               StageTimings *timings,
+                                               const EncodeOptions *encoding) {
+    return runEndToEnd(imageBytes.data(), imageBytes.size(), maskBytes.data(), maskBytes.size(),
+                       timings, encoding);
+}
+
+std::vector<uint8_t> ModelSession::runEndToEnd(const uint8_t *imageData, size_t imageSize,
+                                               const uint8_t *maskData, size_t maskSize,
+                                               StageTimings *timings,
+                                               const EncodeOptions *encoding) {
+    if (!imageData || imageSize == 0)
         throw std::invalid_argument("runEndToEnd: imageBytes is empty");
-    if (maskBytes.empty())
+    if (!maskData || maskSize == 0)
         throw std::invalid_argument("runEndToEnd: maskBytes is empty");
-    cv::Mat image = decodeBytesToMat_(imageBytes, cv::IMREAD_COLOR);     // BGR, 3ch
-    cv::Mat mask = decodeBytesToMat_(maskBytes, cv::IMREAD_GRAYSCALE); // 1ch
+    const EncodeOptions &enc = encoding ? *encoding : settings_.encoding;
+    uint64_t key = 0;
+    if (result_cache_) {
+        key = request_key_(imageData, imageSize, maskData, maskSize, enc);
+        if (auto hit = result_cache_->get(key)) {
+            LOGI("[RESULT] hit %s", hash_to_hex(key).c_str());
+            if (timings) {
+                *timings = StageTimings{};
+                timings->cache_hit = true;
+            }
+            return std::move(*hit);
+        }
+    }
+    StageTimings t;
+    cv::Mat image, mask;
+    {
+        STAGE_TIMER(t.decode_ms);
+        image = decodeBytesToMat_(imageData, imageSize, cv::IMREAD_COLOR, decode_min_size_()); // BGR, 3ch
+        mask = decodeBytesToMat_(maskData, maskSize, cv::IMREAD_GRAYSCALE, decode_min_size_()); // 1ch
+    }
 
-    auto outputMats = run(image, mask);
+    auto outputMats = run(image, mask, &t);
     if (outputMats.empty()) throw std::runtime_error("no outputs from session");
     //Take first input
-    return encodeMat_(outputMats[0], ".png");
+    std::vector<uint8_t> encoded;
+    {
+        STAGE_TIMER(t.encode_ms);
+        encoded = encodeMat_(outputMats[0], enc);
+    }
+    profiler_.record(t);
+    if (result_cache_) result_cache_->put(key, encoded);
+    if (timings) *timings = t;
+    return encoded;
+}
+
+
+cv::Mat ModelSession::runImage(const cv::Mat &image, const cv::Mat &mask, StageTimings *timings) {
+    StageTimings t;
+    auto outputMats = run(image, mask, &t);
+    if (outputMats.empty()) throw std::runtime_error("no outputs from session");
+    profiler_.record(t);
+    if (timings) *timings = t;
+    return outputMats[0];
 }
 
+std::vector<uint8_t> ModelSession::runProgressive(
+        const std::vector<uint8_t> &imageBytes,
+        const std::vector<uint8_t> &maskBytes,
+        const std::function<void(const std::vector<uint8_t> &)> &on_preview,
+        CancelToken *cancel,
+        StageTimings *timings,
+        const EncodeOptions *encoding) {
+    if (imageBytes.empty())
+        throw std::invalid_argument("runProgressive: imageBytes is empty");
+    if (maskBytes.empty())
+        throw std::invalid_argument("runProgressive: maskBytes is empty");
+    const EncodeOptions &enc = encoding ? *encoding : settings_.encoding;
+    // A cached result needs no preview
+    uint64_t key = 0;
+    if (result_cache_) {
+        key = request_key_(imageBytes.data(), imageBytes.size(), maskBytes.data(), maskBytes.size(),
+                           enc);
+        if (auto hit = result_cache_->get(key)) {
+            LOGI("[RESULT] hit %s", hash_to_hex(key).c_str());
+            if (timings) {
+                *timings = StageTimings{};
+                timings->cache_hit = true;
+            }
+            return std::move(*hit);
+        }
+    }
+    StageTimings t;
+    cv::Mat image, mask;
+    {
+        STAGE_TIMER(t.decode_ms);
+        image = decodeBytesToMat_(imageBytes.data(), imageBytes.size(), cv::IMREAD_COLOR,
+                                  decode_min_size_());
+        mask = decodeBytesToMat_(maskBytes.data(), maskBytes.size(), cv::IMREAD_GRAYSCALE,
+                                 decode_min_size_());
+    }
 
-std::vector<cv::Mat> ModelSession::run(const cv::Mat &image, const cv::Mat &mask) {
     try {
+        StageTimings preview_t;
+        cv::Mat preview = preview_(image, mask, preview_t, cancel);
+        if (!preview.empty() && on_preview) {
+            std::vector<uint8_t> encoded;
+            {
+                STAGE_TIMER(preview_t.encode_ms);
+                encoded = encodeMat_(preview, enc);
+            }
+            LOGI("[PREVIEW] ready after %.1f ms", t.decode_ms + preview_t.total_ms());
+            on_preview(encoded);
+        }
+        if (cancel) cancel->throw_if_cancelled();
+
+        auto outputMats = run(image, mask, &t, cancel);
+        if (outputMats.empty()) throw std::runtime_error("no outputs from session");
+        std::vector<uint8_t> encoded;
+        {
+            STAGE_TIMER(t.encode_ms);
+            encoded = encodeMat_(outputMats[0], enc);
+        }
+        // Stage stats describe the full result only, as for runEndToEnd
+        profiler_.record(t);
+        if (result_cache_) result_cache_->put(key, encoded);
+        if (timings) *timings = t;
+        return encoded;
+    } catch (...) {
+        // A terminated session.Run surfaces as Ort::Exception
+        if (cancel && cancel->cancelled()) {
+            LOGI("[PREVIEW] request cancelled");
+            return {};
+        }
+        throw;
+    }
+}
+
+void ModelSession::set_result_cache(std::shared_ptr<ResultCache> cache) {
+    if (cache && !result_cache_) {
+        const std::string meta = result_fingerprint(settings_) + ";ort=" + Ort::GetVersionString();
+        result_key_ = hash_combine(content_hash_(), hash_bytes(meta.data(), meta.size()));
+    }
+    result_cache_ = std::move(cache);
+}
+
+uint64_t ModelSession::content_hash_() {
+    if (model_hash_ == 0) {
+        const std::string &dir = settings_.optimized_model_cache_dir;
+        model_hash_ = model_file_ ? model_content_hash(*model_file_, dir)
+                                  : model_content_hash(model_path_, dir);
+    }
+    return model_hash_;
+}
+
+uint64_t ModelSession::request_key_(const uint8_t *imageData, size_t imageSize,
+                                    const uint8_t *maskData, size_t maskSize,
+                                    const EncodeOptions &encoding) const {
+    const std::string enc = encode_fingerprint(encoding);
+    const uint64_t inputs = hash_combine(hash_bytes(imageData, imageSize),
+                                         hash_bytes(maskData, maskSize));
+    return hash_combine(hash_combine(result_key_, hash_bytes(enc.data(), enc.size())), inputs);
+}
+
+cv::Mat ModelSession::preview_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t,
+                               CancelToken *cancel) {
+    if (preview_model_) {
+        auto outputs = preview_model_->run(image, mask, &t, cancel);
+        return outputs.empty() ? cv::Mat() : outputs[0];
+    }
+
+    // Only tiling makes the full result cost several passes
+    const bool fits_tiles = image.cols >= image_width_ && image.rows >= image_height_;
+    if (!settings_.tiling.enabled || !fits_tiles) return {};
 
-        __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner",
-                            "run(): img[%dx%d ch=%d type=%d] mask[%dx%d ch=%d type=%d] target=%dx%d | in=%zu out=%zu",
-                            image.cols, image.rows, image.channels(), image.type(),
-                            mask.cols, mask.rows, mask.channels(), mask.type(),
-                            image_width_, image_height_,
-                            input_names_.size(), output_names_.size());
+    cv::Mat bin_mask, result;
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        bin_mask = binarize_mask(mask, image.size());
+        result = image.clone();
+    }
+    if (mask_bounding_box(bin_mask).empty()) return {};
+
+    auto outputs = infer_(image, bin_mask, t, cancel);
+    if (outputs.empty()) throw std::runtime_error("no outputs from session");
+    STAGE_TIMER(t.postprocess_ms);
+    composite_roi(result, cv::Rect(0, 0, image.cols, image.rows), outputs[0], bin_mask);
+    return result;
+}
+
+std::vector<cv::Mat> ModelSession::run(const cv::Mat &image, const cv::Mat &mask,
+                                       StageTimings *timings, CancelToken *cancel) {
+    try {
+
+        LOGI("run(): img[%dx%d ch=%d type=%d] mask[%dx%d ch=%d type=%d] target=%dx%d | in=%zu out=%zu",
+             image.cols, image.rows, image.channels(), image.type(),
+             mask.cols, mask.rows, mask.channels(), mask.type(),
+             image_width_, image_height_,
+             input_names_.size(), output_names_.size());
         // Inputs
         if (image.empty())
             throw std::runtime_error("image is empty");
@@ -55,111 +389,353 @@ std::vector<cv::Mat> ModelSession::run(const cv::Mat &image, const cv::Mat &mask
         if (mask.channels() != 1)
             throw std::runtime_error("mask must have 1 channel (grayscale)");
 
-        cv::Size target(image_width_, image_height_);
-
-        cv::Mat mat_image = image;
-        cv::Mat mat_mask = mask;
-
-        if (mat_mask.size() != target) {
-            cv::resize(mat_mask, mat_mask, target, 0, 0, cv::INTER_NEAREST);
-        }
-        cv::threshold(mat_mask, mat_mask, 127, 255, cv::THRESH_BINARY);
+        StageTimings local;
+        StageTimings &t = timings ? *timings : local;
+        const bool fits_tiles = image.cols >= image_width_ && image.rows >= image_height_;
+        if (settings_.tiling.enabled && fits_tiles)
+            return {run_tiled_(image, mask, t, cancel)};
+        if (settings_.roi.enabled)
+            return {run_roi_(image, mask, t, cancel)};
+        return infer_(image, mask, t, cancel);
+    } catch (const RunCancelled &) {
+        throw;
+    } catch (const Ort::Exception &e) {
+        LOGE("runEndToEnd Ort::Exception: %s", e.what());
+        throw;
+    } catch (const std::exception &e) {
+        LOGE("runEndToEnd std::exception: %s", e.what());
+        throw;
+    } catch (...) {
+        LOGE("runEndToEnd unknown exception");
+        throw;
+    }
+}
 
-        mat_image = cv::dnn::blobFromImage(
-                mat_image, 1.f / 255.f, target, cv::Scalar(), /*swapRB*/
-                true, /*crop*/ false, CV_32F);
-        mat_mask = cv::dnn::blobFromImage(
-                mat_mask, 1.f / 255.f, target, cv::Scalar(), /*swapRB*/
-                false, /*crop*/ false, CV_32F);
+cv::Mat ModelSession::run_roi_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t,
+                               CancelToken *cancel) {
+    const cv::Size model_size(image_width_, image_height_);
+    cv::Mat bin_mask, result;
+    cv::Rect bbox;
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        bin_mask = binarize_mask(mask, image.size());
+        bbox = mask_bounding_box(bin_mask);
+        result = image.clone();
+    }
+    if (bbox.empty()) {
+        LOGI("[ROI] mask is empty, returning input");
+        return result;
+    }
 
-        auto *image_data = reinterpret_cast<float *>(mat_image.data);
-        auto *mask_data = reinterpret_cast<float *>(mat_mask.data);
-        if (mat_image.dims != 4 || mat_mask.dims != 4)
-            throw std::runtime_error("blob must be 4D (NCHW).");
+    const cv::Rect roi = expand_roi(bbox, image.size(), model_size, settings_.roi);
+    LOGI("[ROI] bbox=%dx%d@(%d,%d) crop=%dx%d@(%d,%d) image=%dx%d",
+         bbox.width, bbox.height, bbox.x, bbox.y,
+         roi.width, roi.height, roi.x, roi.y, image.cols, image.rows);
+
+    cv::Mat mask_roi = bin_mask(roi);
+    auto outputs = infer_(image(roi), mask_roi, t, cancel);
+    if (outputs.empty()) throw std::runtime_error("no outputs from session");
+    STAGE_TIMER(t.postprocess_ms);
+    composite_roi(result, roi, outputs[0], mask_roi);
+    return result;
+}
 
-        std::vector<int64_t> image_shape = {mat_image.size[0], mat_image.size[1], mat_image.size[2],
-                                            mat_image.size[3]}; // 1x3xHxW
-        std::vector<int64_t> mask_shape = {mat_mask.size[0], mat_mask.size[1], mat_mask.size[2],
-                                           mat_mask.size[3]};      // 1x1xHxW
+cv::Mat ModelSession::run_tiled_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t,
+                                 CancelToken *cancel) {
+    const cv::Size tile_size(image_width_, image_height_);
+    const TileOptions &opts = settings_.tiling;
+    cv::Mat bin_mask, result;
+    cv::Rect bbox;
+    std::vector<cv::Rect> tiles;
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        bin_mask = binarize_mask(mask, image.size());
+        bbox = mask_bounding_box(bin_mask);
+        result = image.clone();
+        if (!bbox.empty())
+            tiles = plan_tiles(bbox, bin_mask, tile_size, opts.overlap_px);
+    }
+    if (tiles.empty()) {
+        LOGI("[TILE] mask is empty, returning input");
+        return result;
+    }
 
-        std::vector<const char *> input_names_c;
-        for (auto &s: input_names_)
-            input_names_c.push_back(s.c_str());
+    LOGI("[TILE] bbox=%dx%d@(%d,%d) tiles=%zu",
+         bbox.width, bbox.height, bbox.x, bbox.y, tiles.size());
+    std::vector<cv::Mat> patches = run_tiles(image, bin_mask, tiles, &t, cancel);
+
+    STAGE_TIMER(t.postprocess_ms);
+    cv::Rect covered = tiles[0];
+    for (const auto &r: tiles) covered |= r;
+    TileBlender blender(covered, tile_size, opts.overlap_px);
+    for (size_t i = 0; i < tiles.size(); ++i)
+        blender.add(tiles[i], patches[i]);
+    blender.composite(result, bin_mask);
+    return result;
+}
 
-        std::vector<Ort::Value> inputs;
-        inputs.emplace_back(Ort::Value::CreateTensor<float>(
-                mem_info_, image_data, (size_t) mat_image.total(),
-                image_shape.data(), image_shape.size()));
-        inputs.emplace_back(Ort::Value::CreateTensor<float>(
-                mem_info_, mask_data, (size_t) mat_mask.total(),
-                mask_shape.data(), mask_shape.size()));
-
-        // Outputs
-        std::vector<const char *> output_names_c;
-        for (auto &s: output_names_)
-            output_names_c.push_back(s.c_str());
-
-        // Outputs
-        std::vector<Ort::Value> outputs;
-        try {
-            outputs = session_.Run(Ort::RunOptions{},
-                                   input_names_c.data(), inputs.data(), inputs.size(),
-                                   output_names_c.data(), output_names_c.size());
-        } catch (const Ort::Exception &e) {
-            __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner",
-                                "session.Run Ort::Exception: %s", e.what());
-            throw;
-        } catch (const std::exception &e) {
-            __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner",
-                                "session.Run std::exception: %s", e.what());
-            throw;
-        } catch (...) {
-            __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner",
-                                "session.Run unknown exception");
-            throw;
+std::vector<cv::Mat> ModelSession::run_tiles(const cv::Mat &image, const cv::Mat &bin_mask,
+                                             const std::vector<cv::Rect> &tiles,
+                                             StageTimings *timings, CancelToken *cancel) {
+    const size_t workers = std::min<size_t>(
+            tiles.size(), static_cast<size_t>(std::max(1, settings_.tiling.max_parallel)));
+    std::vector<cv::Mat> patches(tiles.size());
+    std::vector<StageTimings> tile_timings(tiles.size());
+    std::atomic<size_t> next{0};
+    std::exception_ptr error = nullptr;
+    std::mutex error_m;
+    auto worker = [&]() {
+        for (size_t i = next++; i < tiles.size(); i = next++) {
+            try {
+                auto outputs = infer_(image(tiles[i]), bin_mask(tiles[i]), tile_timings[i], cancel);
+                if (outputs.empty()) throw std::runtime_error("no outputs from session");
+                patches[i] = outputs[0];
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(error_m);
+                if (!error) error = std::current_exception();
+                next = tiles.size();
+            }
         }
+    };
+    std::vector<std::future<void>> helpers;
+    for (size_t w = 1; w < workers && tile_workers_; ++w) helpers.push_back(tile_workers_->submit(worker));
+    worker();
+    // Queued helpers still reference this frame, so wait for all of them
+    for (auto &h: helpers) h.get();
+    if (error) std::rethrow_exception(error);
+    if (timings)
+        for (const auto &tt: tile_timings) *timings += tt;
+    return patches;
+}
 
+void ModelSession::start_tile_workers_() {
+    const TileOptions &opts = settings_.tiling;
+    if (!opts.enabled || opts.max_parallel <= 1) return;
+    const auto helpers = static_cast<size_t>(opts.max_parallel - 1);
+    tile_workers_ = std::make_unique<Scheduler>(helpers, helpers * 4);
+    LOGI("[TILE] %zu tile worker(s)", helpers);
+}
 
+std::vector<cv::Mat> ModelSession::infer_(const cv::Mat &image, const cv::Mat &mask,
+                                          StageTimings &t, CancelToken *cancel) {
+    if (in_count < 2)
+        throw std::runtime_error("model must take (image, mask) inputs");
+    if (cancel) cancel->throw_if_cancelled();
+    if (batcher_)
+        return infer_batched_(image, mask, t, cancel);
+
+    // Resize, RGB swap, scaling and mask threshold in one pass into the slot tensors
+    std::unique_ptr<IoSlot> slot = acquire_slot_();
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        fill_inputs_(image, mask, slot->inputs[0].GetTensorMutableRawData(),
+                     slot->inputs[1].GetTensorMutableRawData());
+    }
 
-        // Process outputs
-        std::vector<cv::Mat> output_mats(outputs.size());
-        for (size_t i = 0; i < outputs.size(); ++i)
-            output_mats[i] = ort_output_to_mat(outputs[i]);
-
-        return output_mats;
+    try {
+        STAGE_TIMER(t.run_ms);
+        session_.Run(cancel ? cancel->run_options() : run_options_, slot->binding);
     } catch (const Ort::Exception &e) {
-        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner",
-                            "runEndToEnd Ort::Exception: %s", e.what());
+        if (cancel && cancel->cancelled()) throw RunCancelled();
+        LOGE("session.Run Ort::Exception: %s", e.what());
         throw;
     } catch (const std::exception &e) {
-        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner",
-                            "runEndToEnd std::exception: %s", e.what());
+        LOGE("session.Run std::exception: %s", e.what());
         throw;
     } catch (...) {
-        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner",
-                            "runEndToEnd unknown exception");
+        LOGE("session.Run unknown exception");
         throw;
     }
+
+    // Preallocated outputs are reused; dynamic ones were allocated by ORT into the binding
+    STAGE_TIMER(t.postprocess_ms);
+    std::vector<Ort::Value> dynamic_outputs;
+    if (slot->outputs.empty())
+        dynamic_outputs = slot->binding.GetOutputValues();
+    const std::vector<Ort::Value> &outputs = slot->outputs.empty() ? dynamic_outputs
+                                                                    : slot->outputs;
+
+    // Process outputs
+    std::vector<cv::Mat> output_mats(outputs.size());
+    for (size_t i = 0; i < outputs.size(); ++i)
+        output_mats[i] = ort_output_to_mat(outputs[i]);
+
+    release_slot_(std::move(slot));
+    return output_mats;
+}
+
+void ModelSession::fill_inputs_(const cv::Mat &image, const cv::Mat &mask,
+                                void *image_dst, void *mask_dst) {
+    if (input_types_[0] == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16)
+        image_to_nchw(image, static_cast<uint16_t *>(image_dst), image_width_, image_height_);
+    else
+        image_to_nchw(image, static_cast<float *>(image_dst), image_width_, image_height_);
+
+    if (input_types_[1] == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16)
+        mask_to_nchw(mask, static_cast<uint16_t *>(mask_dst), image_width_, image_height_);
+    else
+        mask_to_nchw(mask, static_cast<float *>(mask_dst), image_width_, image_height_);
+}
+
+void ModelSession::start_batcher_() {
+    const BatchOptions &opts = settings_.batching;
+    if (!opts.enabled || opts.max_batch <= 1) return;
+    if (!batch_dynamic_ || in_count != 2) {
+        LOGE("[BATCH] model has no dynamic batch dim on its (image, mask) inputs, batching off");
+        return;
+    }
+    batcher_ = std::make_unique<MicroBatcher<std::shared_ptr<BatchRequest>>>(
+            static_cast<size_t>(opts.max_batch), std::chrono::microseconds(opts.window_us),
+            [this](std::vector<std::shared_ptr<BatchRequest>> &batch) { run_batch_(batch); });
+    LOGI("[BATCH] max_batch=%d window=%d us", opts.max_batch, opts.window_us);
+}
+
+std::vector<cv::Mat> ModelSession::infer_batched_(const cv::Mat &image, const cv::Mat &mask,
+                                                  StageTimings &t, CancelToken *cancel) {
+    auto req = std::make_shared<BatchRequest>();
+    {
+        STAGE_TIMER(t.preprocess_ms);
+        const size_t plane = static_cast<size_t>(image_width_) * image_height_;
+        req->image.resize(3 * plane * element_bytes(input_types_[0]));
+        req->mask.resize(plane * element_bytes(input_types_[1]));
+        fill_inputs_(image, mask, req->image.data(), req->mask.data());
+    }
+    if (cancel) cancel->throw_if_cancelled();
+    std::future<std::vector<cv::Mat>> result = req->result.get_future();
+    batcher_->submit(req);
+    std::vector<cv::Mat> outputs = result.get();
+    t.run_ms += req->run_ms;
+    t.postprocess_ms += req->postprocess_ms;
+    return outputs;
+}
+
+void ModelSession::run_batch_(std::vector<std::shared_ptr<BatchRequest>> &batch) {
+    const size_t n = batch.size();
+    try {
+        Ort::AllocatorWithDefaultOptions allocator;
+        std::vector<Ort::Value> inputs;
+        inputs.reserve(2);
+        for (size_t k = 0; k < 2; ++k) {
+            std::vector<int64_t> shp = input_shapes_[k];
+            shp[0] = static_cast<int64_t>(n);
+            inputs.emplace_back(Ort::Value::CreateTensor(allocator, shp.data(), shp.size(),
+                                                         input_types_[k]));
+            auto *dst = static_cast<uint8_t *>(inputs.back().GetTensorMutableRawData());
+            for (const auto &req: batch) {
+                const std::vector<uint8_t> &src = k == 0 ? req->image : req->mask;
+                std::memcpy(dst, src.data(), src.size());
+                dst += src.size();
+            }
+        }
+
+        double run_ms = 0, post_ms = 0;
+        std::vector<Ort::Value> outputs;
+        {
+            STAGE_TIMER(run_ms);
+            outputs = session_.Run(run_options_, input_names_c_.data(), inputs.data(), inputs.size(),
+                                   output_names_c_.data(), output_names_c_.size());
+        }
+        std::vector<std::vector<cv::Mat>> mats(n);
+        {
+            STAGE_TIMER(post_ms);
+            for (size_t i = 0; i < n; ++i)
+                for (const auto &out: outputs)
+                    mats[i].push_back(ort_output_to_mat(out, i));
+        }
+        LOGI("[BATCH] n=%zu run=%.1f ms", n, run_ms);
+
+        for (size_t i = 0; i < n; ++i) {
+            batch[i]->run_ms = run_ms;
+            batch[i]->postprocess_ms = post_ms / static_cast<double>(n);
+            batch[i]->result.set_value(std::move(mats[i]));
+        }
+    } catch (...) {
+        LOGE("[BATCH] batch of %zu failed", n);
+        for (auto &req: batch) req->result.set_exception(std::current_exception());
+    }
+}
+
+std::unique_ptr<ModelSession::IoSlot> ModelSession::make_slot_() {
+    Ort::AllocatorWithDefaultOptions allocator;
+    auto slot = std::make_unique<IoSlot>();
+    slot->binding = Ort::IoBinding(session_);
+
+    slot->inputs.reserve(in_count);
+    for (size_t i = 0; i < in_count; ++i) {
+        const auto &shp = input_shapes_[i];
+        for (int64_t d: shp)
+            if (d <= 0) throw std::runtime_error("dynamic input dims are not supported");
+        slot->inputs.emplace_back(Ort::Value::CreateTensor(
+                allocator, shp.data(), shp.size(), input_types_[i]));
+        slot->binding.BindInput(input_names_c_[i], slot->inputs[i]);
+    }
+
+    // Output shapes follow from the fixed input shapes; batch is pinned to 1 like the inputs.
+    bool static_outputs = true;
+    for (const auto &shp: output_shapes_)
+        for (size_t d = 1; d < shp.size(); ++d)
+            if (shp[d] <= 0) static_outputs = false;
+
+    if (static_outputs) {
+        slot->outputs.reserve(out_count);
+        for (size_t i = 0; i < out_count; ++i) {
+            std::vector<int64_t> shp = output_shapes_[i];
+            if (!shp.empty() && shp[0] <= 0) shp[0] = 1;
+            slot->outputs.emplace_back(Ort::Value::CreateTensor(
+                    allocator, shp.data(), shp.size(), output_types_[i]));
+            slot->binding.BindOutput(output_names_c_[i], slot->outputs[i]);
+        }
+    } else {
+        for (size_t i = 0; i < out_count; ++i)
+            slot->binding.BindOutput(output_names_c_[i], mem_info_);
+    }
+    return slot;
+}
+
+std::unique_ptr<ModelSession::IoSlot> ModelSession::acquire_slot_() {
+    {
+        std::lock_guard<std::mutex> lk(slots_m_);
+        if (!free_slots_.empty()) {
+            auto slot = std::move(free_slots_.back());
+            free_slots_.pop_back();
+            return slot;
+        }
+    }
+    // every slot is busy with a concurrent run, grow the pool
+    return make_slot_();
 }
 
-cv::Mat ModelSession::decodeBytesToMat_(const std::vector<uint8_t> &bytes, int flags) {
-    if (bytes.empty()) throw std::runtime_error("decodeBytesToMat_: empty buffer");
-    cv::Mat buf(1, static_cast<int>(bytes.size()), CV_8U, const_cast<uint8_t *>(bytes.data()));
+void ModelSession::release_slot_(std::unique_ptr<IoSlot> slot) {
+    std::lock_guard<std::mutex> lk(slots_m_);
+    free_slots_.push_back(std::move(slot));
+}
+
+cv::Mat ModelSession::decodeBytesToMat_(const uint8_t *data, size_t size, int flags,
+                                        cv::Size min_size) {
+    if (!data || size == 0) throw std::runtime_error("decodeBytesToMat_: empty buffer");
+    if (size > static_cast<size_t>(std::numeric_limits<int>::max()))
+        throw std::runtime_error("decodeBytesToMat_: buffer too large");
+    if (!min_size.empty() && (flags == cv::IMREAD_COLOR || flags == cv::IMREAD_GRAYSCALE)) {
+        const ImageHeader header = read_image_header(data, size);
+        const DecodePlan plan = plan_decode(header, flags == cv::IMREAD_COLOR, min_size);
+        if (plan.scale > 1)
+            LOGI("[DECODE] %dx%d jpeg at 1/%d", header.width, header.height, plan.scale);
+        flags = plan.flags;
+    }
+    // Wraps the caller's memory: imdecode reads it in place
+    cv::Mat buf(1, static_cast<int>(size), CV_8U, const_cast<uint8_t *>(data));
     cv::Mat img = cv::imdecode(buf, flags);
     if (img.empty()) throw std::runtime_error("imdecode failed");
     return img;
 }
 
-std::vector<uint8_t> ModelSession::encodeMat_(const cv::Mat &img, const std::string &ext = ".png") {
-    std::vector<uint8_t> out;
-    std::vector<int> params;
-    if (ext == ".jpg" || ext == ".jpeg") {
-        params = {cv::IMWRITE_JPEG_QUALITY, 100};
-    }
-    if (!cv::imencode(ext, img, out, params)) {
-        throw std::runtime_error("imencode failed");
-    }
-    return out;
+cv::Size ModelSession::decode_min_size_() const {
+    if (!settings_.reduced_decode || settings_.roi.enabled || settings_.tiling.enabled) return {};
+    return {image_width_, image_height_};
+}
+
+std::vector<uint8_t> ModelSession::encodeMat_(const cv::Mat &img, const EncodeOptions &opts) {
+    return encode_image(img, opts);
 }
 
 void ModelSession::find_input_output_info_() {
@@ -173,21 +749,41 @@ void ModelSession::find_input_output_info_() {
 
     const int64_t batchSize = 1;
 
+    batch_dynamic_ = in_count > 0;
+    input_types_.clear();
+    output_types_.clear();
     for (size_t i = 0; i < in_count; ++i) {
-        std::vector<int64_t> shp = getDataShape(session_.GetInputTypeInfo(i));
+        Ort::TypeInfo info = session_.GetInputTypeInfo(i);
+        input_types_.push_back(info.GetTensorTypeAndShapeInfo().GetElementType());
+        if (!is_supported_type(input_types_.back()))
+            throw std::runtime_error("inputs must be float or float16 tensors");
+        std::vector<int64_t> shp = getDataShape(std::move(info));
         if (!shp.empty() && shp[0] == -1) {
             shp[0] = batchSize;
+        } else {
+            batch_dynamic_ = false;
         }
         input_shapes_.push_back(std::move(shp));
     }
 
     for (size_t i = 0; i < out_count; ++i) {
-        std::vector<int64_t> shp = getDataShape(session_.GetOutputTypeInfo(i));
+        Ort::TypeInfo info = session_.GetOutputTypeInfo(i);
+        output_types_.push_back(info.GetTensorTypeAndShapeInfo().GetElementType());
+        if (!is_supported_type(output_types_.back()))
+            throw std::runtime_error("outputs must be float or float16 tensors");
+        std::vector<int64_t> shp = getDataShape(std::move(info));
+        if (shp.empty() || shp[0] > 0) batch_dynamic_ = false;
         output_shapes_.push_back(std::move(shp));
     }
 
     input_names_ = session_.GetInputNames();
     output_names_ = session_.GetOutputNames();
+    input_names_c_.clear();
+    for (auto &s: input_names_)
+        input_names_c_.push_back(s.c_str());
+    output_names_c_.clear();
+    for (auto &s: output_names_)
+        output_names_c_.push_back(s.c_str());
     image_width_ = static_cast<int>(input_shapes_[0][3]);
     image_height_ = static_cast<int>(input_shapes_[0][2]);
 
@@ -253,66 +849,66 @@ std::vector<int64_t> ModelSession::getDataShape(Ort::TypeInfo info) {
     return shape;
 }
 
-cv::Mat ModelSession::ort_output_to_mat(const Ort::Value &out) {
+cv::Mat ModelSession::ort_output_to_mat(const Ort::Value &out, size_t n) {
     // Take shape
     auto info = out.GetTensorTypeAndShapeInfo();
     auto shp = info.GetShape(); // NCHW expected)
-    if (shp.size() != 4 || shp[0] != 1)
-        throw std::runtime_error("Expected NCHW with N=1.");
+    if (shp.size() != 4 || shp[0] <= static_cast<int64_t>(n))
+        throw std::runtime_error("Expected NCHW with N > item index.");
     const int64_t C = shp[1], H = shp[2], W = shp[3];
     if (C != 1 && C != 3)
         throw std::runtime_error("Only C=1 or C=3 supported.");
 
-    cv::Mat image_u8; // (CV_8U, 1 or 3 channel)
     const size_t plane = static_cast<size_t>(H) * static_cast<size_t>(W);
+    const size_t offset = n * static_cast<size_t>(C) * plane;
+
+    // float and float16 (raw binary16) outputs share the kernels' signatures
+    auto convert = [&](const auto *ptr) {
+        cv::Mat image_u8; // (CV_8U, 1 or 3 channel)
+        if (C == 1) {
+            image_u8.create(static_cast<int>(H), static_cast<int>(W), CV_8UC1);
+            plane_to_gray8(ptr, plane, image_u8.data, 1.f);
+        } else {
+            // [0,1] vs [0,255] output range is a property of the model, probe it once
+            float scale = output_scale_.load(std::memory_order_relaxed);
+            if (scale == 0.f) {
+                scale = detect_output_scale(ptr, plane * 3);
+                output_scale_.store(scale, std::memory_order_relaxed);
+                LOGI("[OUT] output range scale=%.0f", scale);
+            }
+            // planar RGB -> interleaved BGR8 in one pass
+            image_u8.create(static_cast<int>(H), static_cast<int>(W), CV_8UC3);
+            rgb_planar_to_bgr8(ptr, plane, image_u8.data, scale);
+        }
+        return image_u8;
+    };
 
-    const auto *ptr = out.GetTensorData<float>();
-
-    // CHW -> HWC (float)
-    if (C == 1) {
-        cv::Mat ch(H, W, CV_32F, const_cast<float *>(ptr));
-        cv::Mat m = ch.clone();
-        m.convertTo(image_u8, CV_8U);
-    } else if (C == 3) {
-        cv::Mat c0(H, W, CV_32F, const_cast<float *>(ptr + plane * 0));
-        cv::Mat c1(H, W, CV_32F, const_cast<float *>(ptr + plane * 1));
-        cv::Mat c2(H, W, CV_32F, const_cast<float *>(ptr + plane * 2));
-        // Combine planar CHW channels into one interleaved HWC (RGB) image
-        std::vector<cv::Mat> ch = {c0, c1, c2};
-        cv::Mat img32f;
-        cv::merge(ch, img32f);
-
-        double minv, maxv;
-        cv::minMaxLoc(img32f.reshape(1), &minv, &maxv);
-        if (maxv <= 1.0 + 1e-6 && minv >= 0.0)
-            img32f *= 255.0f;
-
-        img32f.convertTo(image_u8, CV_8UC3);
-        // switch back to BGR
-        cv::cvtColor(image_u8, image_u8, cv::COLOR_RGB2BGR);
-    }
-
-    return image_u8;
+    const void *raw = out.GetTensorRawData();
+    if (info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16)
+        return convert(static_cast<const uint16_t *>(raw) + offset);
+    return convert(static_cast<const float *>(raw) + offset);
 }
 
 
 Ort::SessionOptions ModelSession::init_session(RunnerSettings s) {
     Ort::SessionOptions so;
 
-    // Threading
-    so.SetInterOpNumThreads(s.num_cpu_cores);
-    if (!s.use_xnnpack || s.xnnpack.use_session_threads) {
-        so.SetIntraOpNumThreads(s.num_cpu_cores);
+    // Threading: the Env's shared pools, or pools owned by this session
+    const bool global_threads = s.use_global_thread_pools;
+    if (global_threads) {
+        so.DisablePerSessionThreads();
+    } else {
+        so.SetInterOpNumThreads(s.num_cpu_cores);
+        if (!s.use_xnnpack || s.xnnpack.use_session_threads) {
+            so.SetIntraOpNumThreads(s.num_cpu_cores);
+            if (!s.intra_op_affinity.empty())
+                so.AddConfigEntry(kOrtSessionOptionsConfigIntraOpThreadAffinities,
+                                  s.intra_op_affinity.c_str());
+        }
     }
 
     // Graph opt
-    if (s.use_nnapi) {
-        so.SetGraphOptimizationLevel(ORT_ENABLE_BASIC);
-    } else if (s.use_layout_optimization_instead_of_extended) {
-        so.SetGraphOptimizationLevel(ORT_ENABLE_ALL);
-    } else {
-        so.SetGraphOptimizationLevel(ORT_ENABLE_EXTENDED);
-    }
+    so.SetGraphOptimizationLevel(optimization_level(s));
 
     if (s.use_parallel_execution) {
         so.SetExecutionMode(ExecutionMode::ORT_PARALLEL);
@@ -322,7 +918,8 @@ Ort::SessionOptions ModelSession::init_session(RunnerSettings s) {
     if (s.use_xnnpack) {
         so.AddConfigEntry(kOrtSessionOptionsConfigAllowIntraOpSpinning,
                           "0");
-        if (!s.xnnpack.use_session_threads) {
+        // A private XNNPACK pool would oversubscribe next to the global one
+        if (!s.xnnpack.use_session_threads && !global_threads) {
             so.AppendExecutionProvider("XNNPACK",
                                        {{"intra_op_num_threads",
                                          std::to_string(s.num_cpu_cores).c_str()}});
@@ -334,8 +931,12 @@ Ort::SessionOptions ModelSession::init_session(RunnerSettings s) {
 
     // NNAPI (Android)
     if (s.use_nnapi) {
+#ifdef __ANDROID__
         const uint32_t nnapi_flags = NnapiOptions::to_raw(s.nnapi.flags);
         Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_Nnapi(so, nnapi_flags));
+#else
+        throw std::invalid_argument("use_nnapi is only supported on Android");
+#endif
     }
 
 
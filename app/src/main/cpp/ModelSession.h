@@ -4,6 +4,10 @@
 #include <vector>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <future>
 
 #include <onnxruntime_cxx_api.h>
 #include <onnxruntime_c_api.h>
@@ -14,34 +18,183 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 #include "config.h"
+#include "CancelToken.h"
+#include "MicroBatcher.h"
+#include "Scheduler.h"
+#include "profiler.h"
+#include "timing.h"
+
+class WeightSharing;
+class SharedInitializers;
+class MappedFile;
+class ResultCache;
 
 class ModelSession {
 public:
+    // `model_hash`: the model's content hash when the caller already knows it (cache keys);
+    // 0 computes it on first use.
     ModelSession(Ort::Env &env,
                  Ort::MemoryInfo &mem_info,
                  RunnerSettings s,
-                 std::string model_path);
+                 std::string model_path,
+                 std::shared_ptr<WeightSharing> sharing = nullptr,
+                 uint64_t model_hash = 0);
 
-    std::vector<uint8_t> runEndToEnd(const std::vector<uint8_t> &imageBytes,
-                                     const std::vector<uint8_t> &maskBytes);
+    // Model already mapped by the caller (e.g. an uncompressed APK asset); its name()
+    // stands in for the path.
+    ModelSession(Ort::Env &env,
+                 Ort::MemoryInfo &mem_info,
+                 RunnerSettings s,
+                 std::shared_ptr<const MappedFile> model,
+                 std::shared_ptr<WeightSharing> sharing = nullptr,
+                 uint64_t model_hash = 0);
 
-    std::vector<cv::Mat> run(const cv::Mat &image, const cv::Mat &mask);
+    // `timings`, when given, receives the per-stage wall time of this request. `encoding`
+    // overrides RunnerSettings::encoding for this request.
+    std::vector<uint8_t> runEndToEnd(const std::vector<uint8_t> &imageBytes,
+                                     const std::vector<uint8_t> &maskBytes,
+                                     StageTimings *timings = nullptr,
+                                     const EncodeOptions *encoding = nullptr);
+
+    // runEndToEnd on encoded bytes the caller owns (e.g. a direct ByteBuffer), read in
+    // place; they must stay valid until the call returns.
+    std::vector<uint8_t> runEndToEnd(const uint8_t *imageData, size_t imageSize,
+                                     const uint8_t *maskData, size_t maskSize,
+                                     StageTimings *timings = nullptr,
+                                     const EncodeOptions *encoding = nullptr);
+
+    // Progressive form of runEndToEnd: `on_preview` receives a quick approximation, encoded
+    // like the result, before the full-quality pass starts. Returns the full result, or an
+    // empty vector when `cancel` fired first (the preview may or may not have been sent).
+    std::vector<uint8_t> runProgressive(const std::vector<uint8_t> &imageBytes,
+                                        const std::vector<uint8_t> &maskBytes,
+                                        const std::function<void(const std::vector<uint8_t> &)> &on_preview,
+                                        CancelToken *cancel = nullptr,
+                                        StageTimings *timings = nullptr,
+                                        const EncodeOptions *encoding = nullptr);
+
+    // End-to-end request on already decoded pixels: run() plus stage stats, no decode,
+    // encode or result cache. Returns the first output as BGR, at the input size when ROI
+    // or tiling composite back, otherwise at the model size.
+    cv::Mat runImage(const cv::Mat &image, const cv::Mat &mask, StageTimings *timings = nullptr);
+
+    // Throws RunCancelled once `cancel` fires.
+    std::vector<cv::Mat> run(const cv::Mat &image, const cv::Mat &mask,
+                             StageTimings *timings = nullptr, CancelToken *cancel = nullptr);
+
+    // One model-sized pass per tile of `image` (tiles at most input_size(), e.g. from
+    // plan_tiles), up to tiling.max_parallel at a time. Patches are the raw BGR outputs,
+    // in tile order, for a TileBlender.
+    std::vector<cv::Mat> run_tiles(const cv::Mat &image, const cv::Mat &bin_mask,
+                                   const std::vector<cv::Rect> &tiles,
+                                   StageTimings *timings = nullptr, CancelToken *cancel = nullptr);
+
+    // Model input size (width x height).
+    cv::Size input_size() const { return {image_width_, image_height_}; }
+
+    const RunnerSettings &settings() const { return settings_; }
+
+    // Smaller variant of this model for progressive previews. Without one, the preview is a
+    // single pass over the downscaled frame, upsampled.
+    void set_preview_model(std::shared_ptr<ModelSession> preview) { preview_model_ = std::move(preview); }
+
+    // Serve repeated requests (same image, mask, model and output-relevant settings) from
+    // `cache` in runEndToEnd/runProgressive. Hashes the model once.
+    void set_result_cache(std::shared_ptr<ResultCache> cache);
 
     const std::string &model_path() const { return model_path_; }
 
+    // Aggregated stage timings over the most recent runEndToEnd() requests.
+    StageStats stage_stats() const { return profiler_.stats(); }
+
+    void reset_stage_stats() { profiler_.reset(); }
+
 private:
     // SessionOptions
     Ort::SessionOptions init_session(RunnerSettings s);
 
-    cv::Mat decodeBytesToMat_(const std::vector<uint8_t> &bytes, int flags);
+    // Builds session_, going through the optimized-graph cache when configured.
+    void create_session_(Ort::Env &env, const RunnerSettings &s);
+
+    // Creates session_ from `path`, with shared initializers and prepacked weights when sharing.
+    void open_session_(Ort::Env &env, const std::string &path, Ort::SessionOptions so);
+
+    // Mapping of `path` to create a session from, or null to let ORT read the file.
+    std::shared_ptr<const MappedFile> model_bytes_(const std::string &path) const;
+
+    // Fixed-size model pass: image/mask are resized to the model input.
+    std::vector<cv::Mat> infer_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t,
+                                CancelToken *cancel);
+
+    // infer_ through the micro-batcher: preprocess here, run together with concurrent callers.
+    // Cancellation only applies before the batch runs.
+    std::vector<cv::Mat> infer_batched_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t,
+                                        CancelToken *cancel);
+
+    // Crop-to-mask pass: infer on the padded mask bbox and composite back at full resolution.
+    cv::Mat run_roi_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t, CancelToken *cancel);
+
+    // Native-resolution pass: model-sized overlapping tiles over the mask, feathered together.
+    cv::Mat run_tiled_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t, CancelToken *cancel);
+
+    // Quick approximation of run(): the preview model, or one pass over the whole frame at
+    // model resolution upsampled into the mask. Empty when run() itself is a single pass.
+    cv::Mat preview_(const cv::Mat &image, const cv::Mat &mask, StageTimings &t, CancelToken *cancel);
+
+    // Persistent, ORT-allocated input/output tensors bound once; one slot per concurrent run.
+    struct IoSlot {
+        std::vector<Ort::Value> inputs;
+        std::vector<Ort::Value> outputs; // empty when output dims are dynamic
+        Ort::IoBinding binding{nullptr};
+    };
+
+    std::unique_ptr<IoSlot> make_slot_();
+
+    // One caller's preprocessed inputs waiting in the micro-batcher.
+    struct BatchRequest {
+        std::vector<uint8_t> image, mask; // tensor bytes, float or float16
+        std::promise<std::vector<cv::Mat>> result;
+        double run_ms = 0, postprocess_ms = 0; // valid once result is ready
+    };
+
+    // Fused resize/normalize of image and mask into tensor memory of the input element types.
+    void fill_inputs_(const cv::Mat &image, const cv::Mat &mask, void *image_dst, void *mask_dst);
 
-    std::vector<uint8_t> encodeMat_(const cv::Mat &img, const std::string &ext);
+    void start_batcher_();
+
+    // Helpers for run_tiles when tiling.max_parallel > 1; the calling thread is the last one.
+    void start_tile_workers_();
+
+    // Stacks the requests along N, runs once and splits the outputs back.
+    void run_batch_(std::vector<std::shared_ptr<BatchRequest>> &batch);
+
+    std::unique_ptr<IoSlot> acquire_slot_();
+
+    void release_slot_(std::unique_ptr<IoSlot> slot);
+
+    // `min_size`: the image is only needed that large, allowing reduced JPEG decoding.
+    cv::Mat decodeBytesToMat_(const uint8_t *data, size_t size, int flags, cv::Size min_size = {});
+
+    // Smallest useful decode size for run(): the model input when it will be resized to
+    // that anyway, empty (full resolution) when ROI/tiling composite at full resolution.
+    cv::Size decode_min_size_() const;
+
+    std::vector<uint8_t> encodeMat_(const cv::Mat &img, const EncodeOptions &opts);
 
     void find_input_output_info_();
 
-    cv::Mat ort_output_to_mat(const Ort::Value &out);
+    // Item `n` of the output batch as an 8-bit image.
+    cv::Mat ort_output_to_mat(const Ort::Value &out, size_t n = 0);
 
 private:
+    // Weights shared with other sessions; declared before session_ so they outlive it
+    std::shared_ptr<WeightSharing> sharing_;
+    std::shared_ptr<SharedInitializers> shared_initializers_;
+
+    // Caller-provided model, and the mapping ORT runs from in place (ORT format only)
+    std::shared_ptr<const MappedFile> model_file_;
+    std::shared_ptr<const MappedFile> session_bytes_;
+
     // ORT
     Ort::Session session_{nullptr};
     Ort::MemoryInfo &mem_info_;
@@ -57,7 +210,41 @@ private:
     std::vector<int64_t> getDataShape(Ort::TypeInfo info);
 
     std::vector<std::vector<int64_t>> input_shapes_, output_shapes_;
+    std::vector<ONNXTensorElementDataType> input_types_, output_types_; // float or float16
     size_t in_count, out_count;
     std::vector<std::string> input_names_;
     std::vector<std::string> output_names_;
+    std::vector<const char *> input_names_c_;
+    std::vector<const char *> output_names_c_;
+    Ort::RunOptions run_options_;
+
+    // Output multiplier to 8-bit range, 0 until the first output decides it
+    std::atomic<float> output_scale_{0.f};
+
+    StageProfiler profiler_;
+
+    std::shared_ptr<ModelSession> preview_model_;
+
+    std::shared_ptr<ResultCache> result_cache_;
+    uint64_t result_key_ = 0; // model and settings part of result cache keys
+
+    // Model content hash (cache keys), computed on first use; 0 until then.
+    uint64_t model_hash_ = 0;
+
+    uint64_t content_hash_();
+
+    // Result cache key of one request.
+    uint64_t request_key_(const uint8_t *imageData, size_t imageSize,
+                          const uint8_t *maskData, size_t maskSize,
+                          const EncodeOptions &encoding) const;
+
+    std::mutex slots_m_;
+    std::vector<std::unique_ptr<IoSlot>> free_slots_;
+
+    // Inputs have a dynamic N dim (pinned to 1 in input_shapes_)
+    bool batch_dynamic_ = false;
+
+    // Last: stopped before the session they run on is destroyed
+    std::unique_ptr<MicroBatcher<std::shared_ptr<BatchRequest>>> batcher_;
+    std::unique_ptr<Scheduler> tile_workers_;
 };
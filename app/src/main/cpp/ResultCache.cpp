@@ -0,0 +1,269 @@
+#include "ResultCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#include "ModelCache.h"
+#include "hash.h"
+#include "logging.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr uint64_t kIndexMagic = 0x3258444943534552ull; // "RESCIDX2"
+
+    // Journal record: `key` was stored or used (size > 0) or removed (size 0). Replaying
+    // the records in order rebuilds the index and its recency.
+    struct IndexRecord {
+        uint64_t key, size;
+    };
+    static_assert(sizeof(IndexRecord) == 16, "index records are packed");
+
+    // Compact once the journal holds this many records per live entry (plus slack)
+    constexpr size_t kJournalGrowth = 4;
+    constexpr size_t kJournalSlack = 256;
+}
+
+std::string result_fingerprint(const RunnerSettings &s) {
+    std::string f = optimization_fingerprint(s);
+    f += ";roi=" + std::to_string(s.roi.enabled);
+    if (s.roi.enabled) {
+        f += ";roi_padding=" + std::to_string(s.roi.context_padding);
+        f += ";roi_min_px=" + std::to_string(s.roi.min_context_px);
+    }
+    f += ";tiling=" + std::to_string(s.tiling.enabled);
+    if (s.tiling.enabled) f += ";tile_overlap=" + std::to_string(s.tiling.overlap_px);
+    f += ";reduced_decode=" + std::to_string(s.reduced_decode);
+    return f;
+}
+
+ResultCache::ResultCache(ResultCacheOptions opts) : opts_(std::move(opts)) {
+    if (!opts_.disk_dir.empty()) {
+        std::error_code ec;
+        fs::create_directories(opts_.disk_dir, ec);
+        load_index_();
+    }
+}
+
+std::optional<std::vector<uint8_t>> ResultCache::get(uint64_t key) {
+    {
+        std::lock_guard<std::mutex> lk(memory_m_);
+        auto it = memory_index_.find(key);
+        if (it != memory_index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++memory_hits_;
+            return *it->second->second;
+        }
+    }
+    if (!opts_.disk_dir.empty()) {
+        if (auto value = get_disk_(key)) {
+            put_memory_(key, std::make_shared<const std::vector<uint8_t>>(*value));
+            return value;
+        }
+    }
+    std::lock_guard<std::mutex> lk(memory_m_);
+    ++misses_;
+    return std::nullopt;
+}
+
+void ResultCache::put(uint64_t key, const std::vector<uint8_t> &value) {
+    put_memory_(key, std::make_shared<const std::vector<uint8_t>>(value));
+    if (!opts_.disk_dir.empty()) put_disk_(key, value);
+}
+
+void ResultCache::put_memory_(uint64_t key, Value value) {
+    if (value->size() > opts_.memory_bytes) return;
+    std::lock_guard<std::mutex> lk(memory_m_);
+    auto it = memory_index_.find(key);
+    if (it != memory_index_.end()) {
+        memory_bytes_ -= it->second->second->size();
+        lru_.erase(it->second);
+        memory_index_.erase(it);
+    }
+    memory_bytes_ += value->size();
+    lru_.emplace_front(key, std::move(value));
+    memory_index_[key] = lru_.begin();
+    while (memory_bytes_ > opts_.memory_bytes && !lru_.empty()) {
+        memory_bytes_ -= lru_.back().second->size();
+        memory_index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+std::optional<std::vector<uint8_t>> ResultCache::get_disk_(uint64_t key) {
+    std::lock_guard<std::mutex> lk(disk_m_);
+    auto it = disk_index_.find(key);
+    if (it == disk_index_.end()) return std::nullopt;
+
+    std::vector<uint8_t> value(static_cast<size_t>(it->second.size));
+    FILE *f = std::fopen(entry_path_(key).c_str(), "rb");
+    const bool ok = f && std::fread(value.data(), 1, value.size(), f) == value.size();
+    if (f) std::fclose(f);
+    if (!ok) {
+        LOGE("[RESULT] dropping unreadable entry %s", hash_to_hex(key).c_str());
+        erase_disk_(key);
+        append_index_(key, 0);
+        return std::nullopt;
+    }
+    touch_disk_(key, value.size());
+    append_index_(key, value.size());
+    ++disk_hits_;
+    return value;
+}
+
+void ResultCache::put_disk_(uint64_t key, const std::vector<uint8_t> &value) {
+    if (value.empty() || value.size() > opts_.disk_bytes) return;
+    std::lock_guard<std::mutex> lk(disk_m_);
+    if (disk_index_.count(key)) {
+        touch_disk_(key, value.size());
+        append_index_(key, value.size());
+        return;
+    }
+
+    const std::string path = entry_path_(key);
+    const std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    bool ok = f && std::fwrite(value.data(), 1, value.size(), f) == value.size();
+    if (f) ok = std::fclose(f) == 0 && ok;
+    std::error_code ec;
+    if (ok) fs::rename(tmp, path, ec);
+    if (!ok || ec) {
+        LOGE("[RESULT] cannot write %s", path.c_str());
+        fs::remove(tmp, ec);
+        return;
+    }
+    touch_disk_(key, value.size());
+    append_index_(key, value.size());
+
+    while (disk_bytes_ > opts_.disk_bytes) {
+        const uint64_t oldest = disk_lru_.back();
+        fs::remove(entry_path_(oldest), ec);
+        erase_disk_(oldest);
+        append_index_(oldest, 0);
+    }
+}
+
+void ResultCache::touch_disk_(uint64_t key, uint64_t size) {
+    auto it = disk_index_.find(key);
+    if (it != disk_index_.end()) {
+        disk_lru_.splice(disk_lru_.begin(), disk_lru_, it->second.lru_pos);
+        return;
+    }
+    disk_lru_.push_front(key);
+    disk_index_[key] = DiskEntry{size, disk_lru_.begin()};
+    disk_bytes_ += size;
+}
+
+void ResultCache::erase_disk_(uint64_t key) {
+    auto it = disk_index_.find(key);
+    if (it == disk_index_.end()) return;
+    disk_bytes_ -= it->second.size;
+    disk_lru_.erase(it->second.lru_pos);
+    disk_index_.erase(it);
+}
+
+void ResultCache::clear() {
+    {
+        std::lock_guard<std::mutex> lk(memory_m_);
+        lru_.clear();
+        memory_index_.clear();
+        memory_bytes_ = 0;
+    }
+    if (opts_.disk_dir.empty()) return;
+    std::lock_guard<std::mutex> lk(disk_m_);
+    std::error_code ec;
+    for (const auto &e: disk_index_) fs::remove(entry_path_(e.first), ec);
+    disk_index_.clear();
+    disk_lru_.clear();
+    disk_bytes_ = 0;
+    rewrite_index_();
+}
+
+ResultCache::Stats ResultCache::stats() const {
+    Stats s;
+    {
+        std::lock_guard<std::mutex> lk(memory_m_);
+        s.memory_hits = memory_hits_;
+        s.misses = misses_;
+        s.memory_entries = lru_.size();
+        s.memory_bytes = memory_bytes_;
+    }
+    std::lock_guard<std::mutex> lk(disk_m_);
+    s.disk_hits = disk_hits_;
+    s.disk_entries = disk_index_.size();
+    s.disk_bytes = static_cast<size_t>(disk_bytes_);
+    return s;
+}
+
+std::string ResultCache::entry_path_(uint64_t key) const {
+    return (fs::path(opts_.disk_dir) / (hash_to_hex(key) + ".res")).string();
+}
+
+void ResultCache::load_index_() {
+    const std::string path = (fs::path(opts_.disk_dir) / "index.bin").string();
+    if (FILE *f = std::fopen(path.c_str(), "rb")) {
+        uint64_t magic = 0;
+        if (std::fread(&magic, sizeof(magic), 1, f) == 1 && magic == kIndexMagic) {
+            IndexRecord r{};
+            while (std::fread(&r, sizeof(r), 1, f) == 1) {
+                if (r.size) {
+                    touch_disk_(r.key, r.size);
+                } else {
+                    erase_disk_(r.key);
+                }
+                ++journal_records_;
+            }
+        }
+        std::fclose(f);
+    }
+    // Entries whose file went missing (cleared app cache) are dropped
+    for (auto it = disk_lru_.begin(); it != disk_lru_.end();) {
+        const uint64_t key = *it++;
+        std::error_code ec;
+        if (fs::file_size(entry_path_(key), ec) != disk_index_.at(key).size || ec) erase_disk_(key);
+    }
+    // Always start from a compact journal with a valid header; appends rely on it
+    rewrite_index_();
+    LOGI("[RESULT] disk tier: %zu entries, %llu bytes", disk_index_.size(),
+         static_cast<unsigned long long>(disk_bytes_));
+}
+
+void ResultCache::append_index_(uint64_t key, uint64_t size) {
+    if (journal_records_ >= kJournalGrowth * disk_index_.size() + kJournalSlack) {
+        rewrite_index_();
+        return; // the rewrite already reflects this access
+    }
+    const std::string path = (fs::path(opts_.disk_dir) / "index.bin").string();
+    FILE *f = std::fopen(path.c_str(), "ab");
+    const IndexRecord r{key, size};
+    bool ok = f && std::fwrite(&r, sizeof(r), 1, f) == 1;
+    if (f) ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+        LOGE("[RESULT] cannot append to index %s", path.c_str());
+        return;
+    }
+    ++journal_records_;
+}
+
+void ResultCache::rewrite_index_() {
+    const std::string path = (fs::path(opts_.disk_dir) / "index.bin").string();
+    const std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    bool ok = std::fwrite(&kIndexMagic, sizeof(kIndexMagic), 1, f) == 1;
+    // Least recent first, so replaying restores the order
+    for (auto it = disk_lru_.rbegin(); it != disk_lru_.rend(); ++it) {
+        const IndexRecord r{*it, disk_index_.at(*it).size};
+        ok = ok && std::fwrite(&r, sizeof(r), 1, f) == 1;
+    }
+    ok = std::fclose(f) == 0 && ok;
+    std::error_code ec;
+    if (ok) fs::rename(tmp, path, ec);
+    if (!ok || ec) {
+        LOGE("[RESULT] cannot write index %s", path.c_str());
+        fs::remove(tmp, ec);
+        return;
+    }
+    journal_records_ = disk_index_.size();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+
+// Encoded inference results by content key: a size-bounded in-memory LRU in front of an
+// optional on-disk tier. Disk entries are `<dir>/<key>.res` files listed in a binary
+// journal (`<dir>/index.bin`, 16 bytes per stored, used or removed entry) so startup does
+// not scan the directory and each access costs one append; the journal is compacted once
+// it grows to several times the live entries. The least recently used entries are evicted
+// past the byte budget. Thread-safe.
+class ResultCache {
+public:
+    explicit ResultCache(ResultCacheOptions opts);
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    // Memory first, then disk (promoting the entry to memory).
+    std::optional<std::vector<uint8_t>> get(uint64_t key);
+
+    void put(uint64_t key, const std::vector<uint8_t> &value);
+
+    void clear();
+
+    struct Stats {
+        size_t memory_hits = 0, disk_hits = 0, misses = 0;
+        size_t memory_entries = 0, memory_bytes = 0;
+        size_t disk_entries = 0, disk_bytes = 0;
+    };
+
+    Stats stats() const;
+
+private:
+    using Value = std::shared_ptr<const std::vector<uint8_t>>;
+
+    void put_memory_(uint64_t key, Value value);
+
+    std::optional<std::vector<uint8_t>> get_disk_(uint64_t key);
+
+    void put_disk_(uint64_t key, const std::vector<uint8_t> &value);
+
+    void load_index_();
+
+    // Caller holds disk_m_ for the helpers below.
+    // Marks `key` (of `size` bytes) as the most recently used disk entry.
+    void touch_disk_(uint64_t key, uint64_t size);
+
+    void erase_disk_(uint64_t key);
+
+    // Journals a use (size > 0) or removal (size 0) of `key`, compacting when due.
+    void append_index_(uint64_t key, uint64_t size);
+
+    // Rewrites the journal with one record per live entry, least recent first.
+    void rewrite_index_();
+
+    std::string entry_path_(uint64_t key) const;
+
+    const ResultCacheOptions opts_;
+
+    // Memory tier: most recent first
+    mutable std::mutex memory_m_;
+    std::list<std::pair<uint64_t, Value>> lru_;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Value>>::iterator> memory_index_;
+    size_t memory_bytes_ = 0;
+    size_t memory_hits_ = 0, misses_ = 0;
+
+    // Disk tier
+    struct DiskEntry {
+        uint64_t size = 0;
+        std::list<uint64_t>::iterator lru_pos;
+    };
+    mutable std::mutex disk_m_;
+    std::list<uint64_t> disk_lru_; // most recent first
+    std::unordered_map<uint64_t, DiskEntry> disk_index_;
+    uint64_t disk_bytes_ = 0;
+    size_t journal_records_ = 0;
+    size_t disk_hits_ = 0;
+};
+
+// Settings that change a model's output image, as a stable string: the graph
+// optimizations plus ROI and tiling.
+std::string result_fingerprint(const RunnerSettings &s);
@@ -0,0 +1,41 @@
+#include "Scheduler.h"
+#include "CpuTopology.h"
+
+#include <stdexcept>
+
+#include "logging.h"
+
+Scheduler::Scheduler(size_t workers, size_t queue_capacity, std::vector<int> cpus)
+        : queue_(queue_capacity) {
+    if (workers == 0) throw std::invalid_argument("Scheduler: workers must be > 0");
+    workers_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i)
+        workers_.emplace_back([this, cpus] { worker_loop_(cpus); });
+}
+
+Scheduler::~Scheduler() {
+    queue_.close();
+    for (auto &w: workers_) w.join();
+}
+
+void Scheduler::post(std::function<void()> job) {
+    if (!queue_.push(std::move(job))) throw std::runtime_error("Scheduler: shut down");
+}
+
+bool Scheduler::try_post(std::function<void()> job) {
+    return queue_.try_push(job);
+}
+
+void Scheduler::worker_loop_(const std::vector<int> &cpus) {
+    if (!cpus.empty() && !pin_current_thread(cpus))
+        LOGE("[SCHED] could not pin worker to %zu cpus", cpus.size());
+    while (auto job = queue_.pop()) {
+        try {
+            (*job)();
+        } catch (const std::exception &e) {
+            LOGE("[SCHED] job threw: %s", e.what());
+        } catch (...) {
+            LOGE("[SCHED] job threw: <unknown>");
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-capacity multi-producer/multi-consumer FIFO. push() blocks while full, which is
+// the backpressure producers see; pop() blocks while empty until close().
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    // False once closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lk(m_);
+        not_full_.wait(lk, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        lk.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // False when full or closed; `item` is left untouched then.
+    bool try_push(T &item) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (closed_ || items_.size() >= capacity_) return false;
+            items_.push_back(std::move(item));
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Empty once closed and drained.
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lk(m_);
+        not_empty_.wait(lk, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return std::nullopt;
+        T item = std::move(items_.front());
+        items_.pop_front();
+        lk.unlock();
+        not_full_.notify_one();
+        return item;
+    }
+
+    // Rejects further pushes; queued items are still handed out.
+    void close() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return items_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    const size_t capacity_;
+    mutable std::mutex m_;
+    std::condition_variable not_full_, not_empty_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+// Long-lived worker threads draining a bounded request queue. Replaces spawning threads
+// per request: workers are started once and requests beyond the queue capacity wait
+// (submit) or are refused (try_submit) instead of piling up.
+class Scheduler {
+public:
+    // Workers restrict themselves to `cpus` when given (see CpuTopology).
+    Scheduler(size_t workers, size_t queue_capacity, std::vector<int> cpus = {});
+
+    // Finishes queued work, then joins the workers.
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    // Queues `fn`, blocking while the queue is full. The future carries its result or
+    // exception. Throws std::runtime_error after shutdown.
+    template<typename F>
+    auto submit(F fn) -> std::future<std::invoke_result_t<F>> {
+        auto task = make_task_(std::move(fn));
+        auto fut = task->get_future();
+        post([task] { (*task)(); });
+        return fut;
+    }
+
+    // Like submit() but returns nullopt instead of waiting when the queue is full.
+    template<typename F>
+    auto try_submit(F fn) -> std::optional<std::future<std::invoke_result_t<F>>> {
+        auto task = make_task_(std::move(fn));
+        auto fut = task->get_future();
+        if (!try_post([task] { (*task)(); })) return std::nullopt;
+        return fut;
+    }
+
+    // Fire-and-forget form for callback-style callers; `job` must not throw.
+    void post(std::function<void()> job);
+
+    bool try_post(std::function<void()> job);
+
+    size_t workers() const { return workers_.size(); }
+
+    size_t queued() const { return queue_.size(); }
+
+    size_t capacity() const { return queue_.capacity(); }
+
+private:
+    template<typename F>
+    static auto make_task_(F fn) {
+        using R = std::invoke_result_t<F>;
+        return std::make_shared<std::packaged_task<R()>>(std::move(fn));
+    }
+
+    void worker_loop_(const std::vector<int> &cpus);
+
+    BoundedQueue<std::function<void()>> queue_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,196 @@
+#include "WeightSharing.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "logging.h"
+
+namespace {
+
+// Initializers below this size stay in the graph (shape constants etc.)
+constexpr size_t kMinSharedBytes = 1024;
+constexpr size_t kArenaAlign = 64;
+
+// Minimal protobuf reader, just enough to walk ModelProto.graph.initializer.
+struct PbReader {
+    const uint8_t *p;
+    const uint8_t *end;
+
+    bool done() const { return p >= end; }
+
+    uint64_t varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) throw std::runtime_error("onnx: truncated varint");
+            const uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        throw std::runtime_error("onnx: bad varint");
+    }
+
+    PbReader bytes() {
+        const uint64_t n = varint();
+        if (n > static_cast<uint64_t>(end - p)) throw std::runtime_error("onnx: truncated field");
+        PbReader sub{p, p + n};
+        p += n;
+        return sub;
+    }
+
+    void skip(uint32_t wire_type) {
+        switch (wire_type) {
+            case 0: varint(); break;
+            case 1: advance(8); break;
+            case 2: bytes(); break;
+            case 5: advance(4); break;
+            default: throw std::runtime_error("onnx: unsupported wire type");
+        }
+    }
+
+    void advance(size_t n) {
+        if (n > static_cast<size_t>(end - p)) throw std::runtime_error("onnx: truncated field");
+        p += n;
+    }
+};
+
+struct RawTensor {
+    std::string name;
+    std::vector<int64_t> dims;
+    int32_t data_type = 0;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    bool external = false;
+};
+
+size_t element_size(int32_t onnx_type) {
+    switch (onnx_type) {
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT: return 4;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16: return 2;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_BFLOAT16: return 2;
+        // quantized weights and their int32 biases (QDQ / QOperator models)
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT8: return 1;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_UINT8: return 1;
+        case ONNX_TENSOR_ELEMENT_DATA_TYPE_INT32: return 4;
+        default: return 0; // not shared
+    }
+}
+
+RawTensor parse_tensor(PbReader r) {
+    RawTensor t;
+    while (!r.done()) {
+        const uint64_t key = r.varint();
+        const uint32_t field = static_cast<uint32_t>(key >> 3), wire = key & 7;
+        if (field == 1 && wire == 0) {
+            t.dims.push_back(static_cast<int64_t>(r.varint()));
+        } else if (field == 1 && wire == 2) {
+            PbReader packed = r.bytes();
+            while (!packed.done()) t.dims.push_back(static_cast<int64_t>(packed.varint()));
+        } else if (field == 2 && wire == 0) {
+            t.data_type = static_cast<int32_t>(r.varint());
+        } else if (field == 8 && wire == 2) {
+            PbReader s = r.bytes();
+            t.name.assign(reinterpret_cast<const char *>(s.p), s.end - s.p);
+        } else if (field == 9 && wire == 2) {
+            PbReader s = r.bytes();
+            t.data = s.p;
+            t.size = static_cast<size_t>(s.end - s.p);
+        } else if (field == 14 && wire == 0) {
+            t.external = r.varint() == 1; // DataLocation.EXTERNAL
+        } else {
+            r.skip(wire);
+        }
+    }
+    return t;
+}
+
+std::vector<RawTensor> shareable_initializers(const MappedFile &model) {
+    std::vector<RawTensor> out;
+    PbReader m{model.data(), model.data() + model.size()};
+    while (!m.done()) {
+        const uint64_t key = m.varint();
+        if ((key >> 3) != 7 || (key & 7) != 2) { // ModelProto.graph
+            m.skip(key & 7);
+            continue;
+        }
+        PbReader g = m.bytes();
+        while (!g.done()) {
+            const uint64_t gkey = g.varint();
+            if ((gkey >> 3) != 5 || (gkey & 7) != 2) { // GraphProto.initializer
+                g.skip(gkey & 7);
+                continue;
+            }
+            RawTensor t = parse_tensor(g.bytes());
+            const size_t esize = element_size(t.data_type);
+            if (t.external || !t.data || esize == 0 || t.size < kMinSharedBytes) continue;
+            size_t n = 1;
+            for (int64_t d: t.dims) n *= static_cast<size_t>(d);
+            if (n * esize != t.size) continue;
+            out.push_back(std::move(t));
+        }
+    }
+    return out;
+}
+
+size_t align_up(size_t v) { return (v + kArenaAlign - 1) / kArenaAlign * kArenaAlign; }
+
+} // namespace
+
+SharedInitializers::SharedInitializers(std::shared_ptr<const MappedFile> model)
+        : model_(std::move(model)) {
+    if (!model_) throw std::invalid_argument("SharedInitializers: null model");
+    const std::vector<RawTensor> tensors = shareable_initializers(*model_);
+
+    // Kernels load elements directly; only misaligned tensor data needs a copy
+    auto aligned = [](const RawTensor &t) {
+        return reinterpret_cast<uintptr_t>(t.data) % element_size(t.data_type) == 0;
+    };
+    size_t arena_size = 0;
+    for (const auto &t: tensors)
+        if (!aligned(t)) arena_size += align_up(t.size);
+    uint8_t *base = nullptr;
+    if (arena_size > 0) {
+        arena_.reset(new uint8_t[arena_size + kArenaAlign]);
+        base = arena_.get();
+        base += (kArenaAlign - reinterpret_cast<uintptr_t>(base) % kArenaAlign) % kArenaAlign;
+    }
+
+    const Ort::MemoryInfo cpu = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeDefault);
+    size_t offset = 0;
+    names_.reserve(tensors.size());
+    values_.reserve(tensors.size());
+    for (const auto &t: tensors) {
+        // Read only: ORT never writes to initializers added by the caller
+        void *data = const_cast<uint8_t *>(t.data);
+        if (!aligned(t)) {
+            std::memcpy(base + offset, t.data, t.size);
+            data = base + offset;
+            offset += align_up(t.size);
+            copied_bytes_ += t.size;
+        }
+        bytes_ += t.size;
+        names_.push_back(t.name);
+        values_.push_back(Ort::Value::CreateTensor(
+                cpu, data, t.size, t.dims.data(), t.dims.size(),
+                static_cast<ONNXTensorElementDataType>(t.data_type)));
+    }
+    LOGI("[SHARE] %s: %zu shared initializers, %.1f MB (%.1f MB copied for alignment)",
+         model_->name().c_str(), names_.size(), bytes_ / (1024.0 * 1024.0),
+         copied_bytes_ / (1024.0 * 1024.0));
+}
+
+void SharedInitializers::add_to(Ort::SessionOptions &so) const {
+    for (size_t i = 0; i < names_.size(); ++i)
+        so.AddInitializer(names_[i].c_str(), values_[i]);
+}
+
+WeightSharing::WeightSharing() = default;
+
+std::shared_ptr<SharedInitializers>
+WeightSharing::initializers_for(std::shared_ptr<const MappedFile> model) {
+    std::lock_guard<std::mutex> lk(m_);
+    auto &slot = initializers_[model->name()];
+    if (auto live = slot.lock()) return live;
+    auto fresh = std::make_shared<SharedInitializers>(std::move(model));
+    slot = fresh;
+    return fresh;
+}
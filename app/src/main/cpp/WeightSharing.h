@@ -0,0 +1,56 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <onnxruntime_cxx_api.h>
+#include "MappedFile.h"
+
+// Large float/fp16/int8 initializers of one model file, handed to every session of that
+// file through SessionOptions::AddInitializer. ORT then treats them as shared initializers,
+// which is also what makes their prepacked forms eligible for a PrepackedWeightsContainer.
+// The tensors point straight into the mapped model, so the weights stay clean file-backed
+// pages; only tensors whose data is not aligned to their element size are copied into a
+// small heap arena.
+class SharedInitializers {
+public:
+    // Parses `model` and keeps the mapping alive for the tensors over it.
+    explicit SharedInitializers(std::shared_ptr<const MappedFile> model);
+
+    // This object must outlive every session these were added to.
+    void add_to(Ort::SessionOptions &so) const;
+
+    size_t count() const { return names_.size(); }
+
+    // Bytes of shared initializers, and the part of them copied to the heap.
+    size_t bytes() const { return bytes_; }
+
+    size_t copied_bytes() const { return copied_bytes_; }
+
+private:
+    std::shared_ptr<const MappedFile> model_;
+    std::unique_ptr<uint8_t[]> arena_;
+    size_t bytes_ = 0;
+    size_t copied_bytes_ = 0;
+    std::vector<std::string> names_;
+    std::vector<Ort::Value> values_;
+};
+
+// Weight memory shared by all sessions of one InferenceRunner.
+class WeightSharing {
+public:
+    WeightSharing();
+
+    // Initializers of `model`, loaded on first use and kept while a session holds them.
+    std::shared_ptr<SharedInitializers> initializers_for(std::shared_ptr<const MappedFile> model);
+
+    OrtPrepackedWeightsContainer *prepacked() { return prepacked_; }
+
+private:
+    Ort::PrepackedWeightsContainer prepacked_;
+    std::mutex m_;
+    std::map<std::string, std::weak_ptr<SharedInitializers>> initializers_;
+};
@@ -0,0 +1,313 @@
+// Host benchmark for the inference pipeline (not part of the Android library).
+//
+//   cpponnxrunner_bench --model lama.onnx --image a.jpg --mask a.png [--image b.jpg --mask b.png]
+//                       [--warmup 3] [--iters 20] [--threads N] [--xnnpack] [--roi] [--tiling]
+//                       [--json out.json] [--compare lama_int8.onnx]
+//
+// --compare loads a second (e.g. quantized) model side by side, runs both on the same
+// inputs and adds its latency, memory and PSNR/SSIM against the --model output (over the
+// mask bounding box, where the two can differ).
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "InferenceRunner.h"
+#include "ModelSession.h"
+#include "memory_usage.h"
+#include "profiler.h"
+#include "quality.h"
+#include "roi.h"
+#include "timing.h"
+
+namespace {
+
+struct BenchArgs {
+    std::string model;
+    std::vector<std::string> images;
+    std::vector<std::string> masks;
+    int warmup = 3;
+    int iters = 20;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool xnnpack = false;
+    bool roi = false;
+    bool tiling = false;
+    std::string json_path;
+    std::string compare;
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: cpponnxrunner_bench --model PATH --image PATH --mask PATH [...]\n"
+                 "       [--warmup N] [--iters N] [--threads N] [--xnnpack] [--roi] [--tiling]\n"
+                 "       [--json PATH] [--compare PATH]\n");
+}
+
+BenchArgs parse_args(int argc, char **argv) {
+    BenchArgs a;
+    for (int i = 1; i < argc; ++i) {
+        const std::string k = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::invalid_argument("missing value for " + k);
+            return argv[++i];
+        };
+        if (k == "--model") a.model = value();
+        else if (k == "--image") a.images.push_back(value());
+        else if (k == "--mask") a.masks.push_back(value());
+        else if (k == "--warmup") a.warmup = std::stoi(value());
+        else if (k == "--iters") a.iters = std::stoi(value());
+        else if (k == "--threads") a.threads = std::stoi(value());
+        else if (k == "--xnnpack") a.xnnpack = true;
+        else if (k == "--roi") a.roi = true;
+        else if (k == "--tiling") a.tiling = true;
+        else if (k == "--json") a.json_path = value();
+        else if (k == "--compare") a.compare = value();
+        else throw std::invalid_argument("unknown argument " + k);
+    }
+    if (a.model.empty() || a.images.empty() || a.images.size() != a.masks.size())
+        throw std::invalid_argument("need --model and matching --image/--mask pairs");
+    return a;
+}
+
+std::vector<uint8_t> read_file(const std::string &path) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) throw std::runtime_error("cannot open " + path);
+    return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+const char *const kStageNames[] = {"decode", "preprocess", "run", "postprocess", "encode", "total"};
+
+struct ModelReport {
+    std::string model;
+    double load_ms = 0;
+    long load_rss_kb = -1;     // RSS growth while creating the session
+    long run_peak_rss_kb = -1; // VmHWM above the RSS before the timed runs
+    std::vector<StageSummary> stages;
+    std::vector<std::vector<uint8_t>> outputs; // last encoded output per input pair
+};
+
+struct QualityReport {
+    double psnr_mean = 0, psnr_min = 0, ssim_mean = 0, ssim_min = 0;
+};
+
+long rss_growth(long before_kb, long after_kb) {
+    return before_kb < 0 || after_kb < 0 ? -1 : after_kb - before_kb;
+}
+
+std::shared_ptr<ModelSession> load_model(InferenceRunner &runner, const std::string &path,
+                                         const RunnerSettings &s, ModelReport &report) {
+    report.model = path;
+    const MemoryUsage before = read_memory_usage();
+    auto t0 = StageClock::now();
+    auto session = runner.init_model(path, s);
+    report.load_ms = elapsed_ms(t0);
+    report.load_rss_kb = rss_growth(before.rss_kb, read_memory_usage().rss_kb);
+    return session;
+}
+
+void run_model(ModelSession &session, const BenchArgs &args,
+               const std::vector<std::vector<uint8_t>> &images,
+               const std::vector<std::vector<uint8_t>> &masks, ModelReport &report) {
+    for (int w = 0; w < args.warmup; ++w)
+        for (size_t i = 0; i < images.size(); ++i)
+            session.runEndToEnd(images[i], masks[i]);
+
+    reset_peak_rss();
+    const long base_kb = read_memory_usage().rss_kb;
+    report.outputs.assign(images.size(), {});
+    std::vector<std::vector<double>> samples(6);
+    for (int it = 0; it < args.iters; ++it) {
+        for (size_t i = 0; i < images.size(); ++i) {
+            StageTimings t;
+            report.outputs[i] = session.runEndToEnd(images[i], masks[i], &t);
+            samples[0].push_back(t.decode_ms);
+            samples[1].push_back(t.preprocess_ms);
+            samples[2].push_back(t.run_ms);
+            samples[3].push_back(t.postprocess_ms);
+            samples[4].push_back(t.encode_ms);
+            samples[5].push_back(t.total_ms());
+        }
+    }
+    report.run_peak_rss_kb = rss_growth(base_kb, read_memory_usage().peak_rss_kb);
+    for (auto &v: samples) report.stages.push_back(summarize_ms(std::move(v)));
+}
+
+cv::Mat decode(const std::vector<uint8_t> &bytes) {
+    const cv::Mat buf(1, static_cast<int>(bytes.size()), CV_8UC1, const_cast<uint8_t *>(bytes.data()));
+    return cv::imdecode(buf, cv::IMREAD_COLOR);
+}
+
+// Part of an output the model actually changed: the mask's bounding box, grown by the
+// SSIM window radius (and to at least one window). The whole frame for an empty mask.
+cv::Rect quality_region(const std::vector<uint8_t> &mask_bytes, cv::Size size) {
+    const cv::Mat buf(1, static_cast<int>(mask_bytes.size()), CV_8UC1,
+                      const_cast<uint8_t *>(mask_bytes.data()));
+    const cv::Mat mask = cv::imdecode(buf, cv::IMREAD_GRAYSCALE);
+    const cv::Rect frame(0, 0, size.width, size.height);
+    if (mask.empty()) return frame;
+    const cv::Rect bbox = mask_bounding_box(binarize_mask(mask, size));
+    if (bbox.empty()) return frame;
+
+    constexpr int kWindow = 11;
+    const int grow_x = std::max(kWindow / 2, (kWindow - bbox.width + 1) / 2);
+    const int grow_y = std::max(kWindow / 2, (kWindow - bbox.height + 1) / 2);
+    return cv::Rect(bbox.x - grow_x, bbox.y - grow_y, bbox.width + 2 * grow_x,
+                    bbox.height + 2 * grow_y) & frame;
+}
+
+// Candidate outputs against the reference outputs, decoded back to pixels and compared
+// over the masked region only: pixels outside it are copied from the input by both models
+// and would pull PSNR/SSIM towards a perfect score.
+QualityReport compare_outputs(const ModelReport &ref, const ModelReport &test,
+                              const std::vector<std::vector<uint8_t>> &masks) {
+    QualityReport q;
+    const size_t n = ref.outputs.size();
+    for (size_t i = 0; i < n; ++i) {
+        const cv::Mat a = decode(ref.outputs[i]), b = decode(test.outputs[i]);
+        const cv::Rect region = quality_region(masks[i], a.size());
+        const double p = psnr(a(region), b(region)), s = ssim(a(region), b(region));
+        q.psnr_mean += p / static_cast<double>(n);
+        q.ssim_mean += s / static_cast<double>(n);
+        q.psnr_min = i ? std::min(q.psnr_min, p) : p;
+        q.ssim_min = i ? std::min(q.ssim_min, s) : s;
+    }
+    return q;
+}
+
+void print_report(const ModelReport &r) {
+    std::printf("model=%s load=%.1f ms load_rss=%+ld KiB run_peak_rss=%+ld KiB\n",
+                r.model.c_str(), r.load_ms, r.load_rss_kb, r.run_peak_rss_kb);
+    std::printf("%-12s %6s %9s %9s %9s %9s %9s %9s\n",
+                "stage", "n", "mean", "min", "p50", "p95", "p99", "max");
+    for (size_t k = 0; k < r.stages.size(); ++k) {
+        const StageSummary &m = r.stages[k];
+        std::printf("%-12s %6zu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+                    kStageNames[k], m.count, m.mean_ms, m.min_ms, m.p50_ms, m.p95_ms,
+                    m.p99_ms, m.max_ms);
+    }
+}
+
+// `s` as the contents of a JSON string literal.
+std::string json_escape(const std::string &s) {
+    std::string out;
+    out.reserve(s.size());
+    for (const char c: s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+void write_stages_json(FILE *f, const ModelReport &r, const char *indent) {
+    for (size_t k = 0; k < r.stages.size(); ++k) {
+        const StageSummary &m = r.stages[k];
+        std::fprintf(f, "%s\"%s\": {\"count\": %zu, \"mean_ms\": %.3f, \"min_ms\": %.3f, "
+                        "\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p95_ms\": %.3f, "
+                        "\"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+                     indent, kStageNames[k], m.count, m.mean_ms, m.min_ms, m.p50_ms, m.p90_ms,
+                     m.p95_ms, m.p99_ms, m.max_ms, k + 1 < r.stages.size() ? "," : "");
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    BenchArgs args;
+    try {
+        args = parse_args(argc, argv);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        usage();
+        return 2;
+    }
+
+    RunnerSettings s{};
+    s.num_cpu_cores = args.threads;
+    s.use_xnnpack = args.xnnpack;
+    s.use_nnapi = false;
+    s.roi.enabled = args.roi;
+    s.tiling.enabled = args.tiling;
+
+    try {
+        std::vector<std::vector<uint8_t>> images, masks;
+        for (size_t i = 0; i < args.images.size(); ++i) {
+            images.push_back(read_file(args.images[i]));
+            masks.push_back(read_file(args.masks[i]));
+        }
+
+        // Both models stay loaded, as they would when shipped side by side
+        InferenceRunner runner;
+        ModelReport ref, cand;
+        auto session = load_model(runner, args.model, s, ref);
+        std::shared_ptr<ModelSession> candidate;
+        if (!args.compare.empty()) candidate = load_model(runner, args.compare, s, cand);
+
+        run_model(*session, args, images, masks, ref);
+        if (candidate) run_model(*candidate, args, images, masks, cand);
+
+        std::printf("pairs=%zu warmup=%d iters=%d threads=%d\n",
+                    images.size(), args.warmup, args.iters, args.threads);
+        print_report(ref);
+        QualityReport quality;
+        if (candidate) {
+            quality = compare_outputs(ref, cand, masks);
+            print_report(cand);
+            std::printf("vs reference: psnr mean=%.2f dB min=%.2f dB  ssim mean=%.4f min=%.4f\n",
+                        quality.psnr_mean, quality.psnr_min, quality.ssim_mean, quality.ssim_min);
+        }
+
+        if (!args.json_path.empty()) {
+            FILE *f = std::fopen(args.json_path.c_str(), "w");
+            if (!f) throw std::runtime_error("cannot write " + args.json_path);
+            std::fprintf(f, "{\n  \"model\": \"%s\",\n  \"load_ms\": %.3f,\n"
+                            "  \"load_rss_kb\": %ld,\n  \"run_peak_rss_kb\": %ld,\n"
+                            "  \"threads\": %d,\n  \"xnnpack\": %s,\n  \"roi\": %s,\n"
+                            "  \"tiling\": %s,\n  \"stages\": {\n",
+                         json_escape(ref.model).c_str(), ref.load_ms, ref.load_rss_kb, ref.run_peak_rss_kb,
+                         args.threads, args.xnnpack ? "true" : "false",
+                         args.roi ? "true" : "false", args.tiling ? "true" : "false");
+            write_stages_json(f, ref, "    ");
+            std::fprintf(f, "  }");
+            if (candidate) {
+                std::fprintf(f, ",\n  \"compare\": {\n    \"model\": \"%s\",\n"
+                                "    \"load_ms\": %.3f,\n    \"load_rss_kb\": %ld,\n"
+                                "    \"run_peak_rss_kb\": %ld,\n"
+                                "    \"psnr_db\": {\"mean\": %.3f, \"min\": %.3f},\n"
+                                "    \"ssim\": {\"mean\": %.5f, \"min\": %.5f},\n"
+                                "    \"stages\": {\n",
+                             json_escape(cand.model).c_str(), cand.load_ms, cand.load_rss_kb,
+                             cand.run_peak_rss_kb, quality.psnr_mean, quality.psnr_min,
+                             quality.ssim_mean, quality.ssim_min);
+                write_stages_json(f, cand, "      ");
+                std::fprintf(f, "    }\n  }");
+            }
+            std::fprintf(f, "\n}\n");
+            std::fclose(f);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "benchmark failed: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
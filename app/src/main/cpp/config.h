@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
 struct NnapiOptions {
     enum class Flag : uint32_t {
         None        = 0,
@@ -22,8 +27,94 @@ struct XnnPackOptions {
     bool use_session_threads = false;
 };
 
+struct RoiOptions {
+    bool  enabled = false;
+    float context_padding = 0.5f; // extra context around the mask bbox, as a fraction of its longer side
+    int   min_context_px  = 32;
+};
+
+struct TileOptions {
+    bool enabled      = false;
+    int  overlap_px   = 64; // minimum overlap between neighbouring tiles, feathered when blending
+    int  max_parallel = 1;  // concurrent session.Run calls over tiles
+};
+
+// How results are returned (see encode_image). Unset PNG options pass nothing to OpenCV,
+// which keeps its fast default path (level 1, RLE, PNG_FILTER_SUB); setting either one
+// switches the encoder to zlib's parameters and default filtering.
+struct EncodeOptions {
+    enum class Format {
+        Png,
+        Jpeg,
+        WebpLossless,
+        RawRgba, // uncompressed, for display: 12-byte header then width*height*4 bytes
+    };
+    enum class PngStrategy { Default, Filtered, HuffmanOnly, Rle, Fixed }; // zlib's, in order
+
+    Format                     format       = Format::Png;
+    std::optional<int>         png_level;    // 0 (store) .. 9
+    std::optional<PngStrategy> png_strategy;
+    int                        jpeg_quality = 95;
+};
+
+struct LoadOptions {
+    bool memory_map = true;               // create sessions from a read-only mapping of the model
+    bool use_model_bytes_directly = true; // ORT-format models: use mapped graph and initializers in place
+};
+
+// Micro-batching of concurrent model passes along N; needs a model with a dynamic batch dim.
+struct BatchOptions {
+    bool enabled   = false;
+    int  max_batch = 4;
+    int  window_us = 5000; // how long the first request of a batch waits for company
+};
+
+// Request scheduling of one InferenceRunner, shared by all of its models.
+struct SchedulerOptions {
+    int    workers        = 2; // requests executed concurrently
+    size_t queue_capacity = 8; // queued requests before submitters block / are refused
+};
+
+// ORT thread pools owned by the Env and shared by every session of one InferenceRunner,
+// so concurrent sessions divide the cores instead of each spawning a full set of threads.
+struct GlobalThreadPoolOptions {
+    bool enabled          = false;
+    int  intra_op_threads = 0; // 0: ORT default, one per core
+    int  inter_op_threads = 1; // only used by ORT_PARALLEL execution
+    bool allow_spinning   = false; // spinning workers steal cycles from the other sessions
+    // Per intra-op worker, e.g. "1;2;3" (intra_op_threads - 1 entries; ORT leaves the
+    // calling thread alone). Empty leaves placement to the OS.
+    std::string intra_op_affinity;
+};
+
+// Which cores intra-op pools and scheduler workers run on (see CpuTopology). On
+// big.LITTLE CPUs an op waits for its slowest thread, so one little core slows them all.
+enum class ThreadPlacement {
+    Unpinned,         // thread counts as configured, the kernel places them
+    PerformanceCores, // all but the slowest cluster; thread counts capped to those cores
+    AllCores,         // every online core
+    PerCluster,       // ModelPool replicas get one cluster each, with per-session pools
+};
+
+// Encoded results of earlier requests, keyed by image, mask, model and the settings that
+// change the output; shared by all models of one InferenceRunner (see ResultCache).
+struct ResultCacheOptions {
+    bool        enabled      = false;
+    size_t      memory_bytes = 64u << 20;  // in-memory LRU budget
+    std::string disk_dir;                  // second tier surviving restarts; empty: memory only
+    size_t      disk_bytes   = 256u << 20;
+};
+
+// Settings of one InferenceRunner (as opposed to RunnerSettings, per model).
+struct RunnerOptions {
+    SchedulerOptions        scheduler{};
+    GlobalThreadPoolOptions thread_pools{};
+    ThreadPlacement         placement = ThreadPlacement::Unpinned;
+    ResultCacheOptions      result_cache{};
+};
+
 struct RunnerSettings {
-    int  num_cpu_cores;
+    int  num_cpu_cores; // per-session pool size; unused on global thread pools (GlobalThreadPoolOptions)
 
     bool use_xnnpack   = true;
     bool use_nnapi     = true;
@@ -32,4 +123,27 @@ struct RunnerSettings {
 
     NnapiOptions   nnapi{};
     XnnPackOptions xnnpack{};
+    RoiOptions     roi{};
+    TileOptions    tiling{};
+    LoadOptions    load{};
+    BatchOptions   batching{};
+    EncodeOptions  encoding{};  // default for requests that do not pass their own
+
+    // Share initializers and prepacked weights between the sessions of one InferenceRunner
+    // that load the same model file; the shared tensors point into the mapped file
+    bool share_weights = true;
+
+    // Without ROI/tiling the image only feeds the model-sized input, so JPEGs several times
+    // larger are decoded at 1/2..1/8 scale (see plan_decode) instead of full resolution
+    bool reduced_decode = true;
+
+    // Run on the Env's global thread pools; set by InferenceRunner when it has them
+    bool use_global_thread_pools = false;
+
+    // session.intra_op_thread_affinities of a per-session pool; set by InferenceRunner
+    // from its ThreadPlacement
+    std::string intra_op_affinity;
+
+    // Directory for optimized graphs reused across cold starts, empty disables the cache
+    std::string optimized_model_cache_dir;
 };
@@ -0,0 +1,83 @@
+#include "decode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <opencv2/imgcodecs.hpp>
+
+namespace {
+    uint32_t be16(const uint8_t *p) { return (uint32_t(p[0]) << 8) | p[1]; }
+
+    uint32_t be32(const uint8_t *p) { return (be16(p) << 16) | be16(p + 2); }
+
+    // Frame size from the first SOFn segment
+    ImageHeader jpeg_header(const uint8_t *data, size_t size) {
+        ImageHeader h;
+        h.format = ImageFormat::Jpeg;
+        size_t pos = 2;
+        while (pos + 4 <= size) {
+            if (data[pos] != 0xFF) return h;
+            const uint8_t marker = data[pos + 1];
+            if (marker == 0xFF) { // fill byte
+                ++pos;
+                continue;
+            }
+            if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { // no length
+                pos += 2;
+                continue;
+            }
+            const size_t len = be16(data + pos + 2);
+            const bool sof = marker >= 0xC0 && marker <= 0xCF &&
+                             marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (sof) {
+                if (pos + 9 > size) return h;
+                h.height = static_cast<int>(be16(data + pos + 5));
+                h.width = static_cast<int>(be16(data + pos + 7));
+                return h;
+            }
+            if (marker == 0xDA || len < 2) return h; // scan data before any frame header
+            pos += 2 + len;
+        }
+        return h;
+    }
+}
+
+ImageHeader read_image_header(const uint8_t *data, size_t size) {
+    static const uint8_t kPng[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (size >= 4 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+        return jpeg_header(data, size);
+    ImageHeader h;
+    if (size >= 24 && std::memcmp(data, kPng, 8) == 0 && std::memcmp(data + 12, "IHDR", 4) == 0) {
+        h.format = ImageFormat::Png;
+        h.width = static_cast<int>(be32(data + 16));
+        h.height = static_cast<int>(be32(data + 20));
+    }
+    return h;
+}
+
+DecodePlan plan_decode(const ImageHeader &header, bool color, cv::Size min_size) {
+    DecodePlan plan{color ? cv::IMREAD_COLOR : cv::IMREAD_GRAYSCALE};
+    if (header.format != ImageFormat::Jpeg || header.width <= 0 || header.height <= 0)
+        return plan;
+    const int need = std::max(min_size.width, min_size.height);
+    if (need <= 0) return plan;
+
+    const int shorter = std::min(header.width, header.height);
+    for (int scale: {8, 4, 2}) {
+        // libjpeg rounds scaled sizes up
+        if ((shorter + scale - 1) / scale < need) continue;
+        plan.scale = scale;
+        switch (scale) {
+            case 8:
+                plan.flags = color ? cv::IMREAD_REDUCED_COLOR_8 : cv::IMREAD_REDUCED_GRAYSCALE_8;
+                break;
+            case 4:
+                plan.flags = color ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_GRAYSCALE_4;
+                break;
+            default:
+                plan.flags = color ? cv::IMREAD_REDUCED_COLOR_2 : cv::IMREAD_REDUCED_GRAYSCALE_2;
+                break;
+        }
+        break;
+    }
+    return plan;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+enum class ImageFormat { Unknown, Jpeg, Png };
+
+// Format and stored dimensions from the first bytes of an encoded image, without decoding.
+// Dimensions are 0 when unknown; they ignore EXIF orientation.
+struct ImageHeader {
+    ImageFormat format = ImageFormat::Unknown;
+    int width = 0;
+    int height = 0;
+};
+
+ImageHeader read_image_header(const uint8_t *data, size_t size);
+
+// imdecode flags for an image that is only needed at `min_size` or larger.
+struct DecodePlan {
+    int flags;     // IMREAD_COLOR / IMREAD_GRAYSCALE, or an IMREAD_REDUCED_* variant
+    int scale = 1; // 1, 2, 4 or 8
+};
+
+// Picks the largest IMREAD_REDUCED_* factor that still leaves both sides of the image at
+// least max(min_size) (so any EXIF rotation still covers min_size). JPEG only: libjpeg
+// scales inside the IDCT there, while other formats would be decoded in full and resized.
+DecodePlan plan_decode(const ImageHeader &header, bool color, cv::Size min_size);
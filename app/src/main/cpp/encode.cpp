@@ -0,0 +1,71 @@
+#include "encode.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+    void put_le32(uint8_t *p, uint32_t v) {
+        for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+
+    std::vector<uint8_t> encode_raw_rgba(const cv::Mat &img) {
+        constexpr size_t kHeader = 12;
+        const size_t row = static_cast<size_t>(img.cols) * 4;
+        std::vector<uint8_t> out(kHeader + row * static_cast<size_t>(img.rows));
+        std::memcpy(out.data(), "RGBA", 4);
+        put_le32(out.data() + 4, static_cast<uint32_t>(img.cols));
+        put_le32(out.data() + 8, static_cast<uint32_t>(img.rows));
+        // Convert straight into the output buffer
+        cv::Mat dst(img.rows, img.cols, CV_8UC4, out.data() + kHeader);
+        cv::cvtColor(img, dst, img.channels() == 1 ? cv::COLOR_GRAY2RGBA : cv::COLOR_BGR2RGBA);
+        return out;
+    }
+}
+
+std::vector<uint8_t> encode_image(const cv::Mat &img, const EncodeOptions &opts) {
+    if (img.empty()) throw std::invalid_argument("encode_image: empty image");
+    if (opts.format == EncodeOptions::Format::RawRgba) return encode_raw_rgba(img);
+
+    std::string ext;
+    std::vector<int> params;
+    switch (opts.format) {
+        case EncodeOptions::Format::Png:
+            ext = ".png";
+            // Level first: OpenCV resets the strategy when it sees a level
+            if (opts.png_level) params.insert(params.end(), {cv::IMWRITE_PNG_COMPRESSION, *opts.png_level});
+            if (opts.png_strategy)
+                params.insert(params.end(), {cv::IMWRITE_PNG_STRATEGY, static_cast<int>(*opts.png_strategy)});
+            break;
+        case EncodeOptions::Format::Jpeg:
+            ext = ".jpg";
+            params = {cv::IMWRITE_JPEG_QUALITY, opts.jpeg_quality};
+            break;
+        case EncodeOptions::Format::WebpLossless:
+            ext = ".webp";
+            params = {cv::IMWRITE_WEBP_QUALITY, 101}; // > 100 selects lossless
+            break;
+        case EncodeOptions::Format::RawRgba:
+            break;
+    }
+    std::vector<uint8_t> out;
+    if (!cv::imencode(ext, img, out, params)) throw std::runtime_error("imencode failed: " + ext);
+    return out;
+}
+
+std::string encode_fingerprint(const EncodeOptions &opts) {
+    std::string f = "format=" + std::to_string(static_cast<int>(opts.format));
+    switch (opts.format) {
+        case EncodeOptions::Format::Png:
+            if (opts.png_level) f += ";png_level=" + std::to_string(*opts.png_level);
+            if (opts.png_strategy) f += ";png_strategy=" + std::to_string(static_cast<int>(*opts.png_strategy));
+            break;
+        case EncodeOptions::Format::Jpeg:
+            f += ";jpeg_quality=" + std::to_string(opts.jpeg_quality);
+            break;
+        default:
+            break;
+    }
+    return f;
+}
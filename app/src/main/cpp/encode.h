@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "config.h"
+
+// Encodes a BGR (or grayscale) result as `opts` asks. RawRgba is "RGBA", then width and
+// height as little-endian uint32, then the pixels row by row, 4 bytes each (alpha 255);
+// it skips compression entirely for callers that only display the result.
+std::vector<uint8_t> encode_image(const cv::Mat &img, const EncodeOptions &opts);
+
+// Encoder settings as a stable string, for cache keys.
+std::string encode_fingerprint(const EncodeOptions &opts);
@@ -0,0 +1,105 @@
+#include "fp16.h"
+
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define FP16_NEON 1
+#elif defined(__F16C__)
+#include <immintrin.h>
+#define FP16_F16C 1
+#endif
+
+namespace {
+
+inline uint32_t bits(float v) {
+    uint32_t u;
+    std::memcpy(&u, &v, sizeof(u));
+    return u;
+}
+
+inline float from_bits(uint32_t u) {
+    float v;
+    std::memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+} // namespace
+
+uint16_t float_to_half(float v) {
+    const uint32_t u = bits(v);
+    const uint16_t sign = static_cast<uint16_t>((u >> 16) & 0x8000u);
+    const uint32_t abs = u & 0x7fffffffu;
+
+    if (abs >= 0x7f800000u) // Inf / NaN (keep NaN quiet)
+        return sign | (abs > 0x7f800000u ? 0x7e00u : 0x7c00u);
+    if (abs >= 0x477ff000u) // rounds to >= 65520 -> Inf
+        return sign | 0x7c00u;
+    if (abs < 0x38800000u) { // below the smallest normal half: subnormal or zero
+        if (abs < 0x33000000u) return sign; // < 2^-25 rounds to 0
+        const uint32_t mant = (abs & 0x7fffffu) | 0x800000u;
+        const int shift = 126 - static_cast<int>(abs >> 23); // 14..24
+        uint32_t h = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1), half = 1u << (shift - 1);
+        if (rem > half || (rem == half && (h & 1u))) ++h;
+        return sign | static_cast<uint16_t>(h);
+    }
+    // Normal: rebias exponent, round the 13 dropped mantissa bits to nearest even
+    uint32_t h = (abs - 0x38000000u) >> 13;
+    const uint32_t rem = abs & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;
+    return sign | static_cast<uint16_t>(h);
+}
+
+float half_to_float(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    const uint32_t exp = (h >> 10) & 0x1fu;
+    uint32_t mant = h & 0x3ffu;
+
+    if (exp == 0x1f) return from_bits(sign | 0x7f800000u | (mant << 13));
+    if (exp != 0) return from_bits(sign | ((exp + 112) << 23) | (mant << 13));
+    if (mant == 0) return from_bits(sign);
+    // Subnormal: normalize
+    int e = 113;
+    while (!(mant & 0x400u)) {
+        mant <<= 1;
+        --e;
+    }
+    return from_bits(sign | (static_cast<uint32_t>(e) << 23) | ((mant & 0x3ffu) << 13));
+}
+
+void float_to_half(const float *src, uint16_t *dst, size_t count) {
+    size_t i = 0;
+#if FP16_NEON
+    for (; i + 8 <= count; i += 8) {
+        const float16x8_t h = vcombine_f16(vcvt_f16_f32(vld1q_f32(src + i)),
+                                           vcvt_f16_f32(vld1q_f32(src + i + 4)));
+        vst1q_u16(dst + i, vreinterpretq_u16_f16(h));
+    }
+#elif FP16_F16C
+    for (; i + 8 <= count; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = float_to_half(src[i]);
+}
+
+void half_to_float(const uint16_t *src, float *dst, size_t count) {
+    size_t i = 0;
+#if FP16_NEON
+    for (; i + 8 <= count; i += 8) {
+        const float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(vget_low_f16(h)));
+        vst1q_f32(dst + i + 4, vcvt_f32_f16(vget_high_f16(h)));
+    }
+#elif FP16_F16C
+    for (; i + 8 <= count; i += 8) {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = half_to_float(src[i]);
+}
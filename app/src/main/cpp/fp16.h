@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// IEEE 754 binary16 <-> binary32 bulk conversion (round to nearest even, NaN/Inf and
+// subnormals preserved). Uses F16C on x86 and the NEON conversion instructions on
+// AArch64 when the target has them, scalar bit manipulation otherwise. Half values are
+// passed as raw bits, matching Ort::Float16_t's storage.
+
+void float_to_half(const float *src, uint16_t *dst, size_t count);
+
+void half_to_float(const uint16_t *src, float *dst, size_t count);
+
+uint16_t float_to_half(float v);
+
+float half_to_float(uint16_t h);
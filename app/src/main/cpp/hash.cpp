@@ -0,0 +1,141 @@
+#include "hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t round64(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+    acc ^= round64(0, val);
+    return acc * P1 + P4;
+}
+
+} // namespace
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed) {
+    const auto *p = static_cast<const uint8_t *>(data);
+    const uint8_t *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        const uint8_t *limit = end - 32;
+        do {
+            v1 = round64(v1, read64(p));
+            v2 = round64(v2, read64(p + 8));
+            v3 = round64(v3, read64(p + 16));
+            v4 = round64(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge_round(h, v1);
+        h = merge_round(h, v2);
+        h = merge_round(h, v3);
+        h = merge_round(h, v4);
+    } else {
+        h = seed + P5;
+    }
+    h += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ round64(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (static_cast<uint64_t>(read32(p)) * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl(h ^ (*p * P5), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// hash_file() and hash_content() must agree, so both hash in chunks of this size
+constexpr size_t kFileChunk = 1 << 20;
+
+uint64_t hash_file(const std::string &path) {
+    std::unique_ptr<FILE, int (*)(FILE *)> f(std::fopen(path.c_str(), "rb"), &std::fclose);
+    if (!f) throw std::runtime_error("hash_file: cannot open " + path);
+    std::vector<uint8_t> chunk(kFileChunk);
+    uint64_t h = 0;
+    size_t n;
+    while ((n = std::fread(chunk.data(), 1, chunk.size(), f.get())) > 0)
+        h = hash_combine(h, hash_bytes(chunk.data(), n));
+    if (std::ferror(f.get())) throw std::runtime_error("hash_file: read error " + path);
+    return h;
+}
+
+uint64_t hash_content(const void *data, size_t size) {
+    const auto *p = static_cast<const uint8_t *>(data);
+    uint64_t h = 0;
+    for (size_t off = 0; off < size; off += kFileChunk)
+        h = hash_combine(h, hash_bytes(p + off, std::min(kFileChunk, size - off)));
+    return h;
+}
+
+uint64_t hash_combine(uint64_t a, uint64_t b) {
+    return merge_round(a ^ P5, b);
+}
+
+std::string hash_to_hex(uint64_t h) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+namespace {
+
+std::string stat_identity(const struct stat &st) {
+    const long long mtime_ns = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL +
+                               st.st_mtim.tv_nsec;
+    return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+           std::to_string(st.st_size) + ":" + std::to_string(mtime_ns);
+}
+
+} // namespace
+
+std::string file_identity(const std::string &path) {
+    struct stat st{};
+    return ::stat(path.c_str(), &st) == 0 ? stat_identity(st) : std::string();
+}
+
+std::string file_identity(int fd) {
+    struct stat st{};
+    return ::fstat(fd, &st) == 0 ? stat_identity(st) : std::string();
+}
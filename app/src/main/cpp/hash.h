@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// XXH64 of a buffer. Fast, non-cryptographic; used for cache keys.
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+
+// Content hash of a file, read in fixed-size chunks. Throws if it cannot be read.
+uint64_t hash_file(const std::string &path);
+
+// Same value as hash_file() for a buffer holding the file contents (e.g. a mapping).
+uint64_t hash_content(const void *data, size_t size);
+
+// Order-dependent combination of two hashes.
+uint64_t hash_combine(uint64_t a, uint64_t b);
+
+std::string hash_to_hex(uint64_t h);
+
+// Cheap version stamp of a file: device, inode, size and mtime. It changes whenever the
+// file is replaced, so it can stand in for the contents when memoizing hash_file().
+// Empty when the file cannot be stat'ed.
+std::string file_identity(const std::string &path);
+std::string file_identity(int fd);
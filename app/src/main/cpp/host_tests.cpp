@@ -0,0 +1,275 @@
+// Host unit tests for the parts of the pipeline that need no model (not part of the
+// Android library). Run through ctest, or directly; exits non-zero on failure.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "decode.h"
+#include "encode.h"
+#include "fp16.h"
+#include "ResultCache.h"
+#include "roi.h"
+#include "tiling.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_failures; \
+        } \
+    } while (0)
+
+void test_binarize_mask() {
+    cv::Mat mask(40, 60, CV_8UC1, cv::Scalar(100));
+    mask(cv::Rect(10, 12, 20, 16)).setTo(200);
+    const cv::Mat before = mask.clone();
+
+    // Same size: thresholded into a new buffer, the caller's mask is left alone
+    const cv::Mat bin = binarize_mask(mask, mask.size());
+    CHECK(bin.data != mask.data);
+    CHECK(cv::countNonZero(mask != before) == 0);
+    CHECK(cv::countNonZero(bin) == 20 * 16);
+    CHECK(mask_bounding_box(bin) == cv::Rect(10, 12, 20, 16));
+
+    const cv::Mat big = binarize_mask(mask, cv::Size(120, 80));
+    CHECK(big.size() == cv::Size(120, 80));
+    CHECK(mask_bounding_box(big) == cv::Rect(20, 24, 40, 32));
+    CHECK(mask_bounding_box(cv::Mat::zeros(8, 8, CV_8UC1)).empty());
+}
+
+void test_expand_roi() {
+    const cv::Size image(1000, 800), model(256, 256);
+    const cv::Rect image_rect({0, 0}, image);
+    RoiOptions opts;
+
+    const cv::Rect bbox(400, 300, 40, 20);
+    const cv::Rect roi = expand_roi(bbox, image, model, opts);
+    CHECK((roi & bbox) == bbox);
+    CHECK((roi & image_rect) == roi);
+    CHECK(roi.width >= model.width && roi.height >= model.height);
+    CHECK(std::abs(roi.width - roi.height) <= 1); // model aspect
+
+    // Near a corner the crop is shifted inside the image instead of clipped below model size
+    const cv::Rect corner = expand_roi(cv::Rect(2, 3, 10, 10), image, model, opts);
+    CHECK((corner & image_rect) == corner);
+    CHECK(corner.width >= model.width && corner.height >= model.height);
+
+    // Small images: the whole image at most
+    const cv::Size small(100, 60);
+    CHECK(expand_roi(cv::Rect(10, 10, 5, 5), small, model, opts) == cv::Rect({0, 0}, small));
+    CHECK(expand_roi(cv::Rect(), image, model, opts) == image_rect);
+}
+
+void test_plan_tiles() {
+    cv::Mat mask(700, 900, CV_8UC1, cv::Scalar(0));
+    cv::rectangle(mask, cv::Rect(100, 80, 600, 90), cv::Scalar(255), cv::FILLED);
+    cv::circle(mask, cv::Point(750, 600), 40, cv::Scalar(255), cv::FILLED);
+    const cv::Rect bbox = mask_bounding_box(mask);
+    const cv::Size tile(256, 256);
+    const int overlap = 64;
+
+    const std::vector<cv::Rect> tiles = plan_tiles(bbox, mask, tile, overlap);
+    CHECK(!tiles.empty());
+    cv::Mat covered(mask.size(), CV_8UC1, cv::Scalar(0));
+    for (const auto &r: tiles) {
+        CHECK(r.size() == tile);
+        CHECK((r & cv::Rect({0, 0}, mask.size())) == r);
+        CHECK(cv::countNonZero(mask(r)) > 0); // empty tiles are dropped
+        covered(r).setTo(255);
+    }
+    // Every mask pixel lies in some tile
+    cv::Mat missed;
+    cv::bitwise_and(mask, ~covered, missed);
+    CHECK(cv::countNonZero(missed) == 0);
+    // The gap between the two masked areas needs no tiles
+    CHECK(tiles.size() < 12);
+
+    // A mask smaller than one tile takes exactly one
+    cv::Mat dot(700, 900, CV_8UC1, cv::Scalar(0));
+    dot(cv::Rect(440, 330, 8, 8)).setTo(255);
+    CHECK(plan_tiles(mask_bounding_box(dot), dot, tile, overlap).size() == 1);
+}
+
+void test_fp16_scalar() {
+    // Exactly representable values survive the round trip
+    for (float v: {0.f, -0.f, 1.f, -2.5f, 0.333251953125f, 65504.f, 6.103515625e-5f /* min normal */,
+                   5.9604644775390625e-8f /* min subnormal */}) {
+        CHECK(half_to_float(float_to_half(v)) == v);
+    }
+    CHECK(float_to_half(1.f) == 0x3C00);
+    CHECK(float_to_half(-2.f) == 0xC000);
+    CHECK(std::signbit(half_to_float(float_to_half(-0.f))));
+
+    // Round to nearest even at the halfway points of the 10-bit mantissa
+    CHECK(float_to_half(1.f + std::ldexp(1.f, -11)) == 0x3C00);
+    CHECK(float_to_half(1.f + 3 * std::ldexp(1.f, -11)) == 0x3C02);
+
+    // Overflow to infinity, Inf and NaN preserved
+    CHECK(float_to_half(65520.f) == 0x7C00);
+    CHECK(float_to_half(-INFINITY) == 0xFC00);
+    CHECK(std::isinf(half_to_float(0x7C00)));
+    CHECK(std::isnan(half_to_float(float_to_half(NAN))));
+}
+
+void test_fp16_bulk() {
+    // Odd count so vector paths also run their scalar tails
+    std::vector<float> src;
+    for (int i = 0; i < 1037; ++i)
+        src.push_back(std::ldexp(static_cast<float>(i % 97) - 48.3f, i % 31 - 20));
+    src.push_back(INFINITY);
+    src.push_back(1e-9f);
+
+    std::vector<uint16_t> half(src.size());
+    float_to_half(src.data(), half.data(), src.size());
+    std::vector<float> back(src.size());
+    half_to_float(half.data(), back.data(), half.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+        CHECK(half[i] == float_to_half(src[i]));
+        CHECK(back[i] == half_to_float(half[i]));
+    }
+
+    // Every finite half converts to float and back unchanged
+    std::vector<uint16_t> all;
+    for (uint32_t h = 0; h <= 0xFFFF; ++h)
+        if ((h & 0x7C00) != 0x7C00) all.push_back(static_cast<uint16_t>(h));
+    std::vector<float> f(all.size());
+    half_to_float(all.data(), f.data(), all.size());
+    std::vector<uint16_t> again(all.size());
+    float_to_half(f.data(), again.data(), f.size());
+    CHECK(again == all);
+}
+
+std::vector<uint8_t> bytes(size_t n, uint8_t fill) { return std::vector<uint8_t>(n, fill); }
+
+void test_result_cache_memory_lru() {
+    ResultCacheOptions opts;
+    opts.enabled = true;
+    opts.memory_bytes = 250;
+    ResultCache cache(opts);
+
+    cache.put(1, bytes(100, 1));
+    cache.put(2, bytes(100, 2));
+    CHECK(cache.get(1).has_value()); // 1 is now the most recent
+    cache.put(3, bytes(100, 3));     // over budget: evicts 2
+
+    CHECK(!cache.get(2).has_value());
+    const auto one = cache.get(1);
+    CHECK(one && *one == bytes(100, 1));
+    CHECK(cache.get(3).has_value());
+
+    // Larger than the whole budget: not cached, nothing else evicted
+    cache.put(4, bytes(300, 4));
+    CHECK(!cache.get(4).has_value());
+    const ResultCache::Stats s = cache.stats();
+    CHECK(s.memory_entries == 2 && s.memory_bytes == 200);
+    CHECK(s.misses == 2);
+}
+
+void test_result_cache_disk_tier() {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "cpponnxrunner_host_tests_cache";
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+
+    ResultCacheOptions opts;
+    opts.enabled = true;
+    opts.memory_bytes = 100;
+    opts.disk_dir = dir.string();
+    opts.disk_bytes = 250;
+    {
+        ResultCache cache(opts);
+        cache.put(1, bytes(100, 1));
+        cache.put(2, bytes(100, 2));
+        cache.put(3, bytes(100, 3)); // disk over budget: evicts 1
+        CHECK(!cache.get(1).has_value());
+        const auto two = cache.get(2); // memory holds only 3: served from disk
+        CHECK(two && *two == bytes(100, 2));
+        CHECK(cache.stats().disk_hits == 1);
+        CHECK(cache.stats().disk_entries == 2);
+    }
+    {
+        // The index and its recency survive a restart: 2 was used after 3, so 3 goes first
+        ResultCache cache(opts);
+        CHECK(cache.stats().disk_entries == 2);
+        cache.put(4, bytes(100, 4));
+        CHECK(!cache.get(3).has_value());
+        CHECK(cache.get(2).has_value());
+        CHECK(!cache.get(1).has_value());
+        cache.clear();
+        CHECK(cache.stats().disk_entries == 0);
+    }
+    fs::remove_all(dir, ec);
+}
+
+void test_read_image_header() {
+    const cv::Mat img(21, 37, CV_8UC3, cv::Scalar(10, 200, 90));
+    std::vector<uint8_t> png, jpg;
+    cv::imencode(".png", img, png);
+    cv::imencode(".jpg", img, jpg);
+
+    ImageHeader h = read_image_header(png.data(), png.size());
+    CHECK(h.format == ImageFormat::Png);
+    CHECK(h.width == 37 && h.height == 21);
+
+    h = read_image_header(jpg.data(), jpg.size());
+    CHECK(h.format == ImageFormat::Jpeg);
+    CHECK(h.width == 37 && h.height == 21);
+
+    // Truncated or foreign data: no dimensions
+    h = read_image_header(jpg.data(), 4);
+    CHECK(h.width == 0 && h.height == 0);
+    const uint8_t junk[] = {'G', 'I', 'F', '8', '9', 'a', 0, 0, 0, 0, 0, 0};
+    CHECK(read_image_header(junk, sizeof(junk)).format == ImageFormat::Unknown);
+    CHECK(read_image_header(nullptr, 0).format == ImageFormat::Unknown);
+}
+
+void test_encode_png_defaults() {
+    cv::Mat img(48, 64, CV_8UC3);
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    // Default options are OpenCV's own PNG path, byte for byte
+    std::vector<uint8_t> plain;
+    cv::imencode(".png", img, plain);
+    CHECK(encode_image(img, EncodeOptions{}) == plain);
+
+    // An explicit level still round-trips losslessly
+    EncodeOptions opts;
+    opts.png_level = 6;
+    const std::vector<uint8_t> leveled = encode_image(img, opts);
+    const cv::Mat back = cv::imdecode(leveled, cv::IMREAD_COLOR);
+    CHECK(!back.empty() && cv::norm(back, img, cv::NORM_INF) == 0);
+    CHECK(encode_fingerprint(opts) != encode_fingerprint(EncodeOptions{}));
+}
+
+} // namespace
+
+int main() {
+    test_binarize_mask();
+    test_expand_roi();
+    test_plan_tiles();
+    test_fp16_scalar();
+    test_fp16_bulk();
+    test_result_cache_memory_lru();
+    test_result_cache_disk_tier();
+    test_read_image_header();
+    test_encode_png_defaults();
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all host tests passed\n");
+    return 0;
+}
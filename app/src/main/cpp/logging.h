@@ -1,7 +1,15 @@
 #pragma once
 
+#ifdef __ANDROID__
 #include <android/log.h>
 
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO,  "cpponnxrunner", __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", __VA_ARGS__)
+#else
+// Host builds (benchmark harness)
+#include <cstdio>
+
+#define LOGI(...) (std::fprintf(stderr, "I/cpponnxrunner: " __VA_ARGS__), std::fputc('\n', stderr))
+#define LOGE(...) (std::fprintf(stderr, "E/cpponnxrunner: " __VA_ARGS__), std::fputc('\n', stderr))
+#endif
 
@@ -0,0 +1,24 @@
+#include "memory_usage.h"
+
+#include <cstdio>
+#include <cstring>
+
+MemoryUsage read_memory_usage() {
+    MemoryUsage m;
+    FILE *f = std::fopen("/proc/self/status", "r");
+    if (!f) return m;
+    char line[256];
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, "VmRSS:", 6) == 0) std::sscanf(line + 6, "%ld", &m.rss_kb);
+        else if (std::strncmp(line, "VmHWM:", 6) == 0) std::sscanf(line + 6, "%ld", &m.peak_rss_kb);
+    }
+    std::fclose(f);
+    return m;
+}
+
+bool reset_peak_rss() {
+    FILE *f = std::fopen("/proc/self/clear_refs", "w");
+    if (!f) return false;
+    const bool ok = std::fputs("5", f) >= 0;
+    return std::fclose(f) == 0 && ok;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Resident memory of this process from /proc/self/status, in KiB; -1 where unavailable.
+struct MemoryUsage {
+    long rss_kb = -1;      // VmRSS
+    long peak_rss_kb = -1; // VmHWM, high-water mark since start or the last reset
+};
+
+MemoryUsage read_memory_usage();
+
+// Restarts the VmHWM high-water mark at the current RSS (/proc/self/clear_refs, Linux 4.0+).
+// False when the kernel refuses, in which case the peak keeps covering the whole process life.
+bool reset_peak_rss();
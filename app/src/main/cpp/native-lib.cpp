@@ -1,4 +1,5 @@
 #include "utils.h"
+#include <android/log.h>
 #include <jni.h>
 #include <string>
 #include <vector>
@@ -18,30 +19,171 @@
 
 #include "InferenceRunner.h"
 #include "ModelSession.h"
+#include "MappedFile.h"
+#include "ModelPool.h"
+#include "AutoTuner.h"
+#include "EditSession.h"
+#include "ResultCache.h"
+#include "pixels.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <chrono>
+#include <memory>
+#include <mutex>
+
+#include <android/asset_manager.h>
+#include <android/asset_manager_jni.h>
+#include <unistd.h>
 
 
 // -------------------- Global --------------------
-static InferenceRunner g_runner; // tek Env + MemInfo
-static std::shared_ptr<ModelSession> g_modelA;
-static std::shared_ptr<ModelSession> g_modelB;
+// One intra-op pool for every replica of both models, on the performance cores, so
+// concurrent passes share cores instead of each session spawning its own threads and
+// no op waits on a little core.
+static RunnerOptions app_runner_options() {
+    RunnerOptions o{};
+    o.thread_pools.enabled = true;
+    o.placement = ThreadPlacement::PerformanceCores; // sizes the pool to those cores
+    return o;
+}
 
-extern "C" JNIEXPORT void JNICALL
-Java_com_example_cpponnxrunner_MainActivity_createSession(JNIEnv *env, jobject thiz,
-                                                          jobjectArray modelPaths) {
-    auto paths = JStringArrayToVector(env, modelPaths);
+static InferenceRunner g_runner(app_runner_options()); // tek Env + MemInfo
+// autoTune reinstalls the pools while requests run: only touched through atomic_load /
+// atomic_store, and each request works on its own copy
+static std::shared_ptr<ModelPool> g_modelA;
+static std::shared_ptr<ModelPool> g_modelB;
+
+static std::shared_ptr<ModelPool> model_a() { return std::atomic_load(&g_modelA); }
+
+static std::shared_ptr<ModelPool> model_b() { return std::atomic_load(&g_modelB); }
 
+// Sessions per model; they share weights, and with the global pool above also its threads
+static constexpr int kReplicasPerModel = 2;
+
+// Auto-tuning: the tuner of modelA's file and building both pools with given settings
+// (tuner trials measure exactly what is deployed; install_models installs them).
+static std::unique_ptr<AutoTuner> g_tuner;
+static AutoTuner::PoolFactory g_make_pools;
+static RunnerSettings g_base_settings;
+
+// Defaults until this device has a tuned profile (see autoTune)
+static RunnerSettings app_settings(JNIEnv *env, jstring optimizedCacheDir) {
     RunnerSettings s{};
     s.num_cpu_cores = 4;
     s.use_xnnpack = false;
     s.use_nnapi = false;
     s.use_layout_optimization_instead_of_extended = false;
+    s.roi.enabled = true;
+    s.tiling.enabled = true;
+    s.optimized_model_cache_dir = JString2String(env, optimizedCacheDir);
+    return s;
+}
+
+static void install_models(const RunnerSettings &s) {
+    auto pools = g_make_pools(s);
+    std::atomic_store(&g_modelA, pools.at(0));
+    std::atomic_store(&g_modelB, pools.at(1));
+}
+
+// Loads the models with the stored tuned profile of this device when there is one.
+// `resultCacheDir` holds the disk tier of the result cache; empty keeps results in memory only.
+static void load_models(JNIEnv *env, jstring optimizedCacheDir, jstring profileDir,
+                        jstring resultCacheDir, const std::string &model_name, uint64_t model_hash) {
+    g_base_settings = app_settings(env, optimizedCacheDir);
+    // Lets the tuner skip thread settings the global pools override
+    g_base_settings.use_global_thread_pools = g_runner.global_thread_pools();
+    if (!g_runner.result_cache()) {
+        // Repeated image+mask pairs (retries, undo) are served from memory, then from disk
+        ResultCacheOptions rc{};
+        rc.enabled = true;
+        rc.disk_dir = JString2String(env, resultCacheDir);
+        g_runner.configure_result_cache(rc);
+    }
+    g_tuner = std::make_unique<AutoTuner>(JString2String(env, profileDir), model_name, model_hash);
+    install_models(g_tuner->load(g_base_settings).value_or(g_base_settings));
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_cpponnxrunner_MainActivity_createSession(JNIEnv *env, jobject thiz,
+                                                          jobjectArray modelPaths,
+                                                          jstring optimizedCacheDir,
+                                                          jstring profileDir,
+                                                          jstring resultCacheDir) {
+    auto paths = JStringArrayToVector(env, modelPaths);
+
+    g_make_pools = [paths](const RunnerSettings &s) {
+        return std::vector<std::shared_ptr<ModelPool>>{
+                g_runner.init_pool(paths.at(0), s, kReplicasPerModel),
+                g_runner.init_pool(paths.at(1), s, kReplicasPerModel)};
+    };
+    load_models(env, optimizedCacheDir, profileDir, resultCacheDir, paths.at(0),
+                g_runner.model_hash(paths.at(0), JString2String(env, optimizedCacheDir)));
+
+}
 
-    auto models = g_runner.init_models(paths, s);
+// Maps each model straight out of the APK, no copy to cacheDir. The assets must be stored
+// uncompressed (androidResources.noCompress); otherwise a RuntimeException is thrown and
+// the caller can fall back to createSession().
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_cpponnxrunner_MainActivity_createSessionFromAssets(JNIEnv *env, jobject thiz,
+                                                                    jobject assetManager,
+                                                                    jobjectArray assetNames,
+                                                                    jstring optimizedCacheDir,
+                                                                    jstring profileDir,
+                                                                    jstring resultCacheDir) {
+    try {
+        AAssetManager *mgr = AAssetManager_fromJava(env, assetManager);
+        std::vector<std::shared_ptr<const MappedFile>> mapped;
+        for (const auto &name: JStringArrayToVector(env, assetNames)) {
+            AAsset *asset = AAssetManager_open(mgr, name.c_str(), AASSET_MODE_RANDOM);
+            if (!asset) throw std::runtime_error("asset not found: " + name);
+            off64_t start = 0, length = 0;
+            const int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+            AAsset_close(asset);
+            if (fd < 0) throw std::runtime_error("asset is compressed: " + name);
+            try {
+                mapped.push_back(MappedFile::map(fd, start, static_cast<size_t>(length), name));
+            } catch (...) {
+                close(fd);
+                throw;
+            }
+            close(fd);
+        }
 
-    g_modelA = models[0];
-    g_modelB = models[1];
+        g_make_pools = [mapped](const RunnerSettings &s) {
+            return std::vector<std::shared_ptr<ModelPool>>{
+                    g_runner.init_pool(mapped.at(0), s, kReplicasPerModel),
+                    g_runner.init_pool(mapped.at(1), s, kReplicasPerModel)};
+        };
+        load_models(env, optimizedCacheDir, profileDir, resultCacheDir, mapped.at(0)->name(),
+                    g_runner.model_hash(*mapped.at(0), JString2String(env, optimizedCacheDir)));
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "createSessionFromAssets: %s", e.what());
+        env->ThrowNew(env->FindClass("java/lang/RuntimeException"), e.what());
+    }
+}
 
+// Sweeps RunnerSettings on (image, mask), stores the winner for this device and reloads the
+// models with it. Skipped (returns null) when a stored profile exists, unless `force`.
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_example_cpponnxrunner_MainActivity_autoTune(JNIEnv *env, jobject thiz,
+                                                     jbyteArray image_bytes,
+                                                     jbyteArray mask_bytes,
+                                                     jboolean force) {
+    if (!g_tuner || !g_make_pools) return nullptr;
+    if (!force && g_tuner->load(g_base_settings)) return nullptr;
+    try {
+        const RunnerSettings best = g_tuner->tune(g_base_settings, g_make_pools,
+                                                  JByteArrayToVector(env, image_bytes),
+                                                  JByteArrayToVector(env, mask_bytes));
+        install_models(best);
+        return env->NewStringUTF(g_tuner->profile_path().c_str());
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "autoTune: %s", e.what());
+        env->ThrowNew(env->FindClass("java/lang/RuntimeException"), e.what());
+        return nullptr;
+    }
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -50,6 +192,26 @@ Java_com_example_cpponnxrunner_MainActivity_releaseSession(
     return;
 }
 
+// Per-stage latency stats of the recent requests of each loaded model, as JSON.
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_example_cpponnxrunner_MainActivity_stageStats(JNIEnv *env, jobject /* this */) {
+    const auto pool_a = model_a(), pool_b = model_b();
+    std::string json = "{\"modelA\":";
+    json += pool_a ? pool_a->stage_stats().to_json() : "null";
+    json += ",\"modelB\":";
+    json += pool_b ? pool_b->stage_stats().to_json() : "null";
+    if (const auto &cache = g_runner.result_cache()) {
+        const ResultCache::Stats rs = cache->stats();
+        json += ",\"resultCache\":{\"memoryHits\":" + std::to_string(rs.memory_hits) +
+                ",\"diskHits\":" + std::to_string(rs.disk_hits) +
+                ",\"misses\":" + std::to_string(rs.misses) +
+                ",\"memoryBytes\":" + std::to_string(rs.memory_bytes) +
+                ",\"diskBytes\":" + std::to_string(rs.disk_bytes) + "}";
+    }
+    json += "}";
+    return env->NewStringUTF(json.c_str());
+}
+
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_example_cpponnxrunner_MainActivity_cvVersion(JNIEnv *env, jobject) {
     std::string ver = cv::getVersionString();
@@ -61,7 +223,8 @@ JNIEXPORT jbyteArray JNICALL
 Java_com_example_cpponnxrunner_MainActivity_inferFromBytesParallel(JNIEnv *env, jobject thiz,
                                                                    jbyteArray image_bytes,
                                                                    jbyteArray mask_bytes) {
-    if (!g_modelA || !g_modelB) return nullptr;
+    const auto pool_a = model_a(), pool_b = model_b();
+    if (!pool_a || !pool_b) return nullptr;
 
     // Decode
     std::vector<uint8_t> imgV = JByteArrayToVector(env, image_bytes);
@@ -76,72 +239,28 @@ Java_com_example_cpponnxrunner_MainActivity_inferFromBytesParallel(JNIEnv *env,
 
     long long t1_ms = -1, t2_ms = -1;  // süreler
 
-    // ---- start gate ----
-    std::mutex gate_m;
-    std::condition_variable gate_cv;
-    int ready = 0;
-    bool go = false;
-
-    std::thread th1([&]() {
-        // hazır olduğunu bildir, start sinyalini bekle
-        {
-            std::unique_lock<std::mutex> lk(gate_m);
-            ++ready;
-            gate_cv.notify_all();
-            gate_cv.wait(lk, [&] { return go; });
-        }
+    // Both requests go to the runner's worker pool; each measures its own run time
+    auto timed = [](const std::shared_ptr<ModelPool> &model, const std::vector<uint8_t> &img,
+                    const std::vector<uint8_t> &mask, long long &dt_ms) {
         auto t0 = clock::now();
-        __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner", "T1 start (modelA)");
-        try {
-            pngBytes_1 = g_modelA->runEndToEnd(imgV, maskV);
-        } catch (...) {
-            ex1 = std::current_exception();
-        }
-        auto t1 = clock::now();
-        t1_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-        __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner", "T1 end (modelA), dt=%lld ms",
-                            t1_ms);
-    });
+        auto out = model->runEndToEnd(img, mask);
+        dt_ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - t0).count();
+        return out;
+    };
 
-    std::thread th2([&]() {
-        {
-            std::unique_lock<std::mutex> lk(gate_m);
-            ++ready;
-            gate_cv.notify_all();
-            gate_cv.wait(lk, [&] { return go; });
-        }
-        auto t0 = clock::now();
-        __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner", "T2 start (modelB)");
-        try {
-            pngBytes_2 = g_modelB->runEndToEnd(imgV, maskV);
-        } catch (...) {
-            ex2 = std::current_exception();
-        }
-        auto t1 = clock::now();
-        t2_ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-        __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner", "T2 end (modelB), dt=%lld ms",
-                            t2_ms);
-    });
-
-    // iki thread de "hazır" diyene kadar bekle, sonra aynı anda başlat
-    std::chrono::steady_clock::time_point t_all_start;
-    {
-        std::unique_lock<std::mutex> lk(gate_m);
-        gate_cv.wait(lk, [&] { return ready == 2; });
-        t_all_start = clock::now();
-        go = true;
-        lk.unlock();
-        gate_cv.notify_all();
-    }
+    auto t_all_start = clock::now();
+    __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner", "T1/T2 submit (modelA, modelB)");
+    auto f1 = g_runner.scheduler().submit([&] { return timed(pool_a, imgV, maskV, t1_ms); });
+    auto f2 = g_runner.scheduler().submit([&] { return timed(pool_b, imgV, maskV, t2_ms); });
 
-    th1.join();
-    th2.join();
+    try { pngBytes_1 = f1.get(); } catch (...) { ex1 = std::current_exception(); }
+    try { pngBytes_2 = f2.get(); } catch (...) { ex2 = std::current_exception(); }
 
     auto t_all_end = clock::now();
     auto all_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
             t_all_end - t_all_start).count();
     __android_log_print(ANDROID_LOG_INFO, "cpponnxrunner",
-                        "Both threads finished, total=%lld ms (t1=%lld, t2=%lld)",
+                        "Both requests finished, total=%lld ms (t1=%lld, t2=%lld)",
                         all_ms, t1_ms, t2_ms);
 
     // Hata logları
@@ -179,10 +298,12 @@ Java_com_example_cpponnxrunner_MainActivity_inferFromBytes(JNIEnv *env, jobject
     std::vector<uint8_t> imgV = JByteArrayToVector(env, image_bytes);
     std::vector<uint8_t> maskV = JByteArrayToVector(env, mask_bytes);
 
+    const auto pool = model_a();
+    if (!pool) return nullptr;
     std::vector<uint8_t> pngBytes_1;
     //std::vector<uint8_t> pngBytes_2;
     try {
-        pngBytes_1 = g_modelA->runEndToEnd(imgV, maskV);
+        pngBytes_1 = g_runner.submit(pool, std::move(imgV), std::move(maskV)).get();
         //pngBytes_2 = g_modelB->runEndToEnd(imgV,maskV);
     } catch (...) {
         return nullptr;
@@ -192,3 +313,287 @@ Java_com_example_cpponnxrunner_MainActivity_inferFromBytes(JNIEnv *env, jobject
 }
 
 
+
+// Output encoding from the Java FORMAT_* constants: 0 PNG (`level` = compression 0-9),
+// 1 JPEG (`level` = quality), 2 lossless WebP, 3 raw RGBA (see encode_image).
+static std::optional<EncodeOptions> encode_options(jint format, jint level) {
+    if (format < 0 || format > 3) return std::nullopt;
+    EncodeOptions enc{};
+    enc.format = static_cast<EncodeOptions::Format>(format);
+    if (enc.format == EncodeOptions::Format::Png) {
+        enc.png_level = std::clamp(static_cast<int>(level), 0, 9);
+        enc.png_strategy = EncodeOptions::PngStrategy::Default;
+    } else if (enc.format == EncodeOptions::Format::Jpeg) {
+        enc.jpeg_quality = std::clamp(static_cast<int>(level), 1, 100);
+    }
+    return enc;
+}
+
+// Bitmap in, bitmap out: no PNG encode/decode on either side and no byte[] copies. `image`
+// and `mask` are RGBA_8888 or A_8 (the mask's luma or alpha channel is the mask); the
+// result is scaled into `out` (RGBA_8888), whatever its size. False on failure.
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_example_cpponnxrunner_MainActivity_inferBitmap(JNIEnv *env, jobject thiz,
+                                                        jobject image, jobject mask,
+                                                        jobject out) {
+    const auto pool = model_a();
+    if (!pool) return JNI_FALSE;
+    try {
+        cv::Mat img, m;
+        {
+            // Unlocked before inference: the conversions copy anyway
+            LockedBitmap image_px(env, image), mask_px(env, mask);
+            if (image_px.mat().empty() || mask_px.mat().empty()) return JNI_FALSE;
+            img = pixels_to_bgr(image_px.mat(), image_px.rgba() ? PixelLayout::Rgba : PixelLayout::Gray);
+            m = pixels_to_mask(mask_px.mat(), mask_px.rgba() ? PixelLayout::Rgba : PixelLayout::Gray);
+        }
+        cv::Mat result = g_runner.scheduler().submit([&] { return pool->runImage(img, m); }).get();
+
+        LockedBitmap out_px(env, out);
+        if (!out_px.rgba()) return JNI_FALSE;
+        bgr_to_pixels(result, out_px.mat(), PixelLayout::Rgba);
+        return JNI_TRUE;
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "inferBitmap: %s", e.what());
+        return JNI_FALSE;
+    }
+}
+
+// Raw pixels as Bitmap.getPixels returns them (ARGB ints) with a width * height byte mask;
+// returns ARGB ints at the same size, for Bitmap.createBitmap(int[], ...).
+extern "C"
+JNIEXPORT jintArray JNICALL
+Java_com_example_cpponnxrunner_MainActivity_inferArgb(JNIEnv *env, jobject thiz,
+                                                      jintArray pixels, jbyteArray mask,
+                                                      jint width, jint height) {
+    const auto pool = model_a();
+    if (!pool || !pixels || !mask || width <= 0 || height <= 0) return nullptr;
+    // Computed wide: width * height can overflow jint before the length checks
+    const int64_t pixel_count = static_cast<int64_t>(width) * height;
+    if (pixel_count > std::numeric_limits<jsize>::max()) return nullptr;
+    const auto count = static_cast<jsize>(pixel_count);
+    if (env->GetArrayLength(pixels) != count || env->GetArrayLength(mask) != count) return nullptr;
+    try {
+        // ARGB ints are B, G, R, A bytes in memory on the little-endian ABIs Android ships
+        cv::Mat argb(height, width, CV_8UC4), m(height, width, CV_8UC1);
+        env->GetIntArrayRegion(pixels, 0, count, reinterpret_cast<jint *>(argb.data));
+        env->GetByteArrayRegion(mask, 0, count, reinterpret_cast<jbyte *>(m.data));
+        cv::Mat img = pixels_to_bgr(argb, PixelLayout::Bgra);
+        argb.release();
+
+        cv::Mat result = g_runner.scheduler().submit([&] { return pool->runImage(img, m); }).get();
+        cv::Mat out(height, width, CV_8UC4);
+        bgr_to_pixels(result, out, PixelLayout::Bgra);
+        jintArray arr = env->NewIntArray(count);
+        if (arr) env->SetIntArrayRegion(arr, 0, count, reinterpret_cast<const jint *>(out.data));
+        return arr;
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "inferArgb: %s", e.what());
+        return nullptr;
+    }
+}
+
+// inferFromBytes on direct ByteBuffers: the first `*_length` bytes of each buffer are read
+// in place instead of being copied into native vectors. Returns the encoded result.
+extern "C"
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_cpponnxrunner_MainActivity_inferDirect(JNIEnv *env, jobject thiz,
+                                                        jobject image, jint image_length,
+                                                        jobject mask, jint mask_length) {
+    const DirectBytes img = DirectBufferBytes(env, image), m = DirectBufferBytes(env, mask);
+    const auto pool = model_a();
+    if (!pool || !img.data || !m.data || image_length <= 0 || mask_length <= 0 ||
+        static_cast<size_t>(image_length) > img.size || static_cast<size_t>(mask_length) > m.size)
+        return nullptr;
+    try {
+        // The Java buffers stay referenced by this frame until the job completes
+        auto out = g_runner.scheduler().submit([&] {
+            return pool->runEndToEnd(img.data, static_cast<size_t>(image_length),
+                                         m.data, static_cast<size_t>(mask_length));
+        }).get();
+        return VectorToJByteArray(env, out);
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "inferDirect: %s", e.what());
+        return nullptr;
+    }
+}
+
+// inferDirect writing the result into the direct buffer `out` as well, so nothing crosses
+// into the Java heap. Returns the result size, 0 on failure, or minus the required size
+// when `out` is too small (with the result cache enabled, the retry is a cache hit).
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_example_cpponnxrunner_MainActivity_inferDirectInto(JNIEnv *env, jobject thiz,
+                                                            jobject image, jint image_length,
+                                                            jobject mask, jint mask_length,
+                                                            jobject out) {
+    const DirectBytes img = DirectBufferBytes(env, image), m = DirectBufferBytes(env, mask);
+    const DirectBytes dst = DirectBufferBytes(env, out);
+    const auto pool = model_a();
+    if (!pool || !img.data || !m.data || !dst.data || image_length <= 0 || mask_length <= 0 ||
+        static_cast<size_t>(image_length) > img.size || static_cast<size_t>(mask_length) > m.size)
+        return 0;
+    try {
+        auto result = g_runner.scheduler().submit([&] {
+            return pool->runEndToEnd(img.data, static_cast<size_t>(image_length),
+                                         m.data, static_cast<size_t>(mask_length));
+        }).get();
+        if (result.size() > static_cast<size_t>(std::numeric_limits<jint>::max())) return 0;
+        if (result.size() > dst.size) return -static_cast<jint>(result.size());
+        std::memcpy(dst.data, result.data(), result.size());
+        return static_cast<jint>(result.size());
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "inferDirectInto: %s", e.what());
+        return 0;
+    }
+}
+
+// Progressive request in flight; starting another one cancels it, as does cancelInference
+static std::mutex g_progressive_m;
+static std::shared_ptr<CancelToken> g_progressive_cancel;
+
+// Calls `listener.onPreview(byte[])` once a quick approximation exists, then
+// `onResult(byte[])` with the full result (null when cancelled) or `onError(String)`,
+// all from a worker thread. Both are encoded per `format`/`level` (see encode_options).
+// Returns immediately.
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_cpponnxrunner_MainActivity_inferProgressive(JNIEnv *env, jobject thiz,
+                                                             jbyteArray image_bytes,
+                                                             jbyteArray mask_bytes,
+                                                             jint format, jint level,
+                                                             jobject listener) {
+    // Copied here: the worker must not read the global, which autoTune may replace
+    auto pool = model_a();
+    const auto enc = encode_options(format, level);
+    if (!pool || !enc || !listener) return;
+
+    JavaVM *vm = nullptr;
+    if (env->GetJavaVM(&vm) != JNI_OK) return;
+    jclass cls = env->GetObjectClass(listener);
+    const jmethodID on_preview = env->GetMethodID(cls, "onPreview", "([B)V");
+    const jmethodID on_result = env->GetMethodID(cls, "onResult", "([B)V");
+    const jmethodID on_error = env->GetMethodID(cls, "onError", "(Ljava/lang/String;)V");
+    env->DeleteLocalRef(cls);
+    if (!on_preview || !on_result || !on_error) return; // NoSuchMethodError is pending
+    jobject callback = env->NewGlobalRef(listener);
+
+    auto cancel = std::make_shared<CancelToken>();
+    {
+        std::lock_guard<std::mutex> lk(g_progressive_m);
+        if (g_progressive_cancel) g_progressive_cancel->cancel();
+        g_progressive_cancel = cancel;
+    }
+
+    auto deliver = [vm, callback](jmethodID method, const std::vector<uint8_t> *bytes) {
+        ScopedJniEnv jenv(vm);
+        JNIEnv *e = jenv.get();
+        if (!e) return;
+        jbyteArray arr = bytes ? VectorToJByteArray(e, *bytes) : nullptr;
+        e->CallVoidMethod(callback, method, arr);
+        if (e->ExceptionCheck()) e->ExceptionClear();
+        if (arr) e->DeleteLocalRef(arr);
+    };
+
+    // try_post: a full queue reports an error instead of blocking the caller
+    bool queued = false;
+    try {
+        queued = g_runner.scheduler().try_post(
+                [vm, callback, cancel, deliver, on_preview, on_result, on_error, pool, enc = *enc,
+                 img = JByteArrayToVector(env, image_bytes),
+                 mask = JByteArrayToVector(env, mask_bytes)] {
+                    try {
+                        std::vector<uint8_t> out = pool->runProgressive(
+                                img, mask,
+                                [&](const std::vector<uint8_t> &preview) { deliver(on_preview, &preview); },
+                                cancel.get(), nullptr, &enc);
+                        deliver(on_result, out.empty() ? nullptr : &out);
+                    } catch (const std::exception &e) {
+                        ScopedJniEnv jenv(vm);
+                        if (JNIEnv *je = jenv.get()) {
+                            jstring msg = je->NewStringUTF(e.what());
+                            je->CallVoidMethod(callback, on_error, msg);
+                            if (je->ExceptionCheck()) je->ExceptionClear();
+                            je->DeleteLocalRef(msg);
+                        }
+                    }
+                    {
+                        std::lock_guard<std::mutex> lk(g_progressive_m);
+                        if (g_progressive_cancel == cancel) g_progressive_cancel.reset();
+                    }
+                    ScopedJniEnv jenv(vm);
+                    if (JNIEnv *je = jenv.get()) je->DeleteGlobalRef(callback);
+                });
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "inferProgressive: %s", e.what());
+    }
+    if (!queued) {
+        {
+            std::lock_guard<std::mutex> lk(g_progressive_m);
+            if (g_progressive_cancel == cancel) g_progressive_cancel.reset();
+        }
+        jstring msg = env->NewStringUTF("could not queue inference (queue full)");
+        env->CallVoidMethod(listener, on_error, msg);
+        env->DeleteLocalRef(msg);
+        env->DeleteGlobalRef(callback);
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_cpponnxrunner_MainActivity_cancelInference(JNIEnv * /*env*/, jobject /* this */) {
+    std::lock_guard<std::mutex> lk(g_progressive_m);
+    if (g_progressive_cancel) g_progressive_cancel->cancel();
+}
+
+// Interactive mask editing of one image (see EditSession)
+static std::mutex g_edit_m;
+static std::shared_ptr<EditSession> g_edit; // guarded by g_edit_m; swapped, never held while running
+
+// Starts editing `image`; later masks only recompute what they changed.
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_cpponnxrunner_MainActivity_beginEdit(JNIEnv *env, jobject thiz,
+                                                      jbyteArray image_bytes) {
+    auto pool = model_a();
+    if (!pool) return;
+    try {
+        auto edit = std::make_shared<EditSession>(std::move(pool), JByteArrayToVector(env, image_bytes));
+        std::lock_guard<std::mutex> lk(g_edit_m);
+        g_edit = std::move(edit);
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "beginEdit: %s", e.what());
+    }
+}
+
+// Result for the full current mask of the edit session as PNG; null without beginEdit or on error.
+extern "C"
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_cpponnxrunner_MainActivity_applyEdit(JNIEnv *env, jobject thiz,
+                                                      jbyteArray mask_bytes) {
+    std::vector<uint8_t> maskV = JByteArrayToVector(env, mask_bytes);
+    std::shared_ptr<EditSession> edit;
+    {
+        std::lock_guard<std::mutex> lk(g_edit_m);
+        edit = g_edit;
+    }
+    if (!edit) return nullptr;
+    try {
+        return VectorToJByteArray(env, edit->apply(maskV));
+    } catch (const std::exception &e) {
+        __android_log_print(ANDROID_LOG_ERROR, "cpponnxrunner", "applyEdit: %s", e.what());
+        return nullptr;
+    }
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_example_cpponnxrunner_MainActivity_endEdit(JNIEnv * /*env*/, jobject /* this */) {
+    std::shared_ptr<EditSession> edit;
+    {
+        std::lock_guard<std::mutex> lk(g_edit_m);
+        edit.swap(g_edit);
+    }
+    // An applyEdit still running keeps its own reference and frees the session when done
+}
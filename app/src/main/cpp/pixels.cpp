@@ -0,0 +1,58 @@
+#include "pixels.h"
+
+#include <stdexcept>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+    void check_channels(const cv::Mat &m, PixelLayout layout) {
+        const int expected = layout == PixelLayout::Gray ? 1 : 4;
+        if (m.empty() || m.depth() != CV_8U || m.channels() != expected)
+            throw std::invalid_argument("pixels: buffer does not match its layout");
+    }
+}
+
+cv::Mat pixels_to_bgr(const cv::Mat &src, PixelLayout layout) {
+    check_channels(src, layout);
+    cv::Mat bgr;
+    switch (layout) {
+        case PixelLayout::Rgba:
+            cv::cvtColor(src, bgr, cv::COLOR_RGBA2BGR);
+            break;
+        case PixelLayout::Bgra:
+            cv::cvtColor(src, bgr, cv::COLOR_BGRA2BGR);
+            break;
+        case PixelLayout::Gray:
+            cv::cvtColor(src, bgr, cv::COLOR_GRAY2BGR);
+            break;
+    }
+    return bgr;
+}
+
+cv::Mat pixels_to_mask(const cv::Mat &src, PixelLayout layout) {
+    check_channels(src, layout);
+    cv::Mat gray;
+    switch (layout) {
+        case PixelLayout::Rgba:
+            cv::cvtColor(src, gray, cv::COLOR_RGBA2GRAY);
+            break;
+        case PixelLayout::Bgra:
+            cv::cvtColor(src, gray, cv::COLOR_BGRA2GRAY);
+            break;
+        case PixelLayout::Gray:
+            gray = src.clone();
+            break;
+    }
+    return gray;
+}
+
+void bgr_to_pixels(const cv::Mat &bgr, cv::Mat &dst, PixelLayout layout) {
+    if (bgr.empty() || bgr.type() != CV_8UC3)
+        throw std::invalid_argument("pixels: result must be 8-bit BGR");
+    if (layout == PixelLayout::Gray || dst.type() != CV_8UC4)
+        throw std::invalid_argument("pixels: destination must be 4-channel");
+
+    cv::Mat src = bgr;
+    if (bgr.size() != dst.size()) cv::resize(bgr, src, dst.size(), 0, 0, cv::INTER_LINEAR);
+    // Same size and type: cvtColor writes into dst's buffer in place
+    cv::cvtColor(src, dst, layout == PixelLayout::Rgba ? cv::COLOR_BGR2RGBA : cv::COLOR_BGR2BGRA);
+}
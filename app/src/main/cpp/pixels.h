@@ -0,0 +1,23 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+// Conversions between in-memory pixel buffers (Android bitmaps, Java int[] pixels) and the
+// BGR / grayscale Mats run() works on, for callers that skip encoding altogether.
+enum class PixelLayout {
+    Rgba, // byte order R, G, B, A: ANDROID_BITMAP_FORMAT_RGBA_8888
+    Bgra, // Java ARGB ints on a little-endian CPU (Bitmap.getPixels)
+    Gray, // ANDROID_BITMAP_FORMAT_A_8, or a plain byte mask
+};
+
+// 3-channel BGR copy of `src` (CV_8UC4, or CV_8UC1 for Gray). Alpha is ignored, so
+// premultiplied pixels are only exact when opaque.
+cv::Mat pixels_to_bgr(const cv::Mat &src, PixelLayout layout);
+
+// Single-channel mask from `src`: Gray as is, otherwise the luma of the colour channels,
+// like a mask image decoded with IMREAD_GRAYSCALE.
+cv::Mat pixels_to_mask(const cv::Mat &src, PixelLayout layout);
+
+// Writes a BGR result into `dst` (CV_8UC4 with alpha 255, wrapping the caller's memory),
+// resizing first when the sizes differ. `dst` is never reallocated.
+void bgr_to_pixels(const cv::Mat &bgr, cv::Mat &dst, PixelLayout layout);
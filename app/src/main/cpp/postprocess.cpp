@@ -0,0 +1,197 @@
+#include "postprocess.h"
+#include "fp16.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PP_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define PP_AVX2 1
+#define PP_SSSE3 1
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define PP_SSSE3 1
+#endif
+
+namespace {
+
+// Pixels per plane widened to float at once by the half-precision entry points
+constexpr size_t kHalfChunk = 512;
+
+inline uint8_t to_u8(float v) {
+    if (!(v > 0.f)) return 0; // also NaN
+    if (v >= 255.f) return 255;
+    return static_cast<uint8_t>(std::lrintf(v));
+}
+
+#if PP_SSSE3
+
+// 16 floats -> 16 saturated bytes
+inline __m128i cvt16_u8(const float *p, __m128 scale) {
+    const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.f);
+    __m128i q[4];
+    for (int k = 0; k < 4; ++k) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(p + 4 * k), scale);
+        v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+        q[k] = _mm_cvtps_epi32(v);
+    }
+    return _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+}
+
+// Interleave 16 B, G and R bytes into 48 bytes of BGR.
+inline void store_bgr48(uint8_t *dst, __m128i b, __m128i g, __m128i r) {
+    const __m128i b0 = _mm_setr_epi8(0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128, 5);
+    const __m128i g0 = _mm_setr_epi8(-128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128);
+    const __m128i r0 = _mm_setr_epi8(-128, -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128);
+    const __m128i b1 = _mm_setr_epi8(-128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10, -128);
+    const __m128i g1 = _mm_setr_epi8(5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10);
+    const __m128i r1 = _mm_setr_epi8(-128, 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128);
+    const __m128i b2 = _mm_setr_epi8(-128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128, -128);
+    const __m128i g2 = _mm_setr_epi8(-128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128);
+    const __m128i r2 = _mm_setr_epi8(10, -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15);
+    auto mix = [&](__m128i mb, __m128i mg, __m128i mr) {
+        return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(b, mb), _mm_shuffle_epi8(g, mg)),
+                            _mm_shuffle_epi8(r, mr));
+    };
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), mix(b0, g0, r0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), mix(b1, g1, r1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), mix(b2, g2, r2));
+}
+
+#endif
+
+#if PP_AVX2
+
+// 32 floats -> 32 saturated bytes, in order
+inline __m256i cvt32_u8(const float *p, __m256 scale) {
+    const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255.f);
+    __m256i q[4];
+    for (int k = 0; k < 4; ++k) {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(p + 8 * k), scale);
+        v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+        q[k] = _mm256_cvtps_epi32(v);
+    }
+    // packs work per 128-bit lane, undo the lane interleave afterwards
+    const __m256i w = _mm256_packus_epi16(_mm256_packs_epi32(q[0], q[1]),
+                                          _mm256_packs_epi32(q[2], q[3]));
+    return _mm256_permutevar8x32_epi32(w, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+#endif
+
+#if PP_NEON
+
+inline uint8x16_t cvt16_u8(const float *p, float32x4_t scale) {
+    const float32x4_t lo = vdupq_n_f32(0.f), hi = vdupq_n_f32(255.f);
+    uint16x4_t q[4];
+    for (int k = 0; k < 4; ++k) {
+        float32x4_t v = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(p + 4 * k), scale), lo), hi);
+#if defined(__aarch64__)
+        q[k] = vqmovun_s32(vcvtnq_s32_f32(v));
+#else
+        q[k] = vqmovun_s32(vcvtq_s32_f32(vaddq_f32(v, vdupq_n_f32(0.5f))));
+#endif
+    }
+    return vcombine_u8(vqmovn_u16(vcombine_u16(q[0], q[1])),
+                       vqmovn_u16(vcombine_u16(q[2], q[3])));
+}
+
+#endif
+
+} // namespace
+
+void rgb_planar_to_bgr8(const float *src, size_t count, uint8_t *dst, float scale) {
+    const float *r = src, *g = src + count, *b = src + 2 * count;
+    size_t i = 0;
+#if PP_NEON
+    const float32x4_t vs = vdupq_n_f32(scale);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t px;
+        px.val[0] = cvt16_u8(b + i, vs);
+        px.val[1] = cvt16_u8(g + i, vs);
+        px.val[2] = cvt16_u8(r + i, vs);
+        vst3q_u8(dst + 3 * i, px);
+    }
+#elif PP_AVX2
+    const __m256 vs = _mm256_set1_ps(scale);
+    for (; i + 32 <= count; i += 32) {
+        const __m256i vb = cvt32_u8(b + i, vs);
+        const __m256i vg = cvt32_u8(g + i, vs);
+        const __m256i vr = cvt32_u8(r + i, vs);
+        store_bgr48(dst + 3 * i, _mm256_castsi256_si128(vb), _mm256_castsi256_si128(vg),
+                    _mm256_castsi256_si128(vr));
+        store_bgr48(dst + 3 * i + 48, _mm256_extracti128_si256(vb, 1),
+                    _mm256_extracti128_si256(vg, 1), _mm256_extracti128_si256(vr, 1));
+    }
+#elif PP_SSSE3
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 16 <= count; i += 16) {
+        store_bgr48(dst + 3 * i, cvt16_u8(b + i, vs), cvt16_u8(g + i, vs), cvt16_u8(r + i, vs));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[3 * i + 0] = to_u8(b[i] * scale);
+        dst[3 * i + 1] = to_u8(g[i] * scale);
+        dst[3 * i + 2] = to_u8(r[i] * scale);
+    }
+}
+
+void plane_to_gray8(const float *src, size_t count, uint8_t *dst, float scale) {
+    size_t i = 0;
+#if PP_NEON
+    const float32x4_t vs = vdupq_n_f32(scale);
+    for (; i + 16 <= count; i += 16)
+        vst1q_u8(dst + i, cvt16_u8(src + i, vs));
+#elif PP_AVX2
+    const __m256 vs = _mm256_set1_ps(scale);
+    for (; i + 32 <= count; i += 32)
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), cvt32_u8(src + i, vs));
+#elif PP_SSSE3
+    const __m128 vs = _mm_set1_ps(scale);
+    for (; i + 16 <= count; i += 16)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), cvt16_u8(src + i, vs));
+#endif
+    for (; i < count; ++i)
+        dst[i] = to_u8(src[i] * scale);
+}
+
+float detect_output_scale(const float *src, size_t count) {
+    if (count == 0) return 1.f;
+    const auto mm = std::minmax_element(src, src + count);
+    return (*mm.first >= 0.f && *mm.second <= 1.f + 1e-6f) ? 255.f : 1.f;
+}
+
+void rgb_planar_to_bgr8(const uint16_t *src, size_t count, uint8_t *dst, float scale) {
+    float buf[3 * kHalfChunk];
+    for (size_t i = 0; i < count; i += kHalfChunk) {
+        const size_t n = std::min(kHalfChunk, count - i);
+        for (size_t c = 0; c < 3; ++c)
+            half_to_float(src + c * count + i, buf + c * n, n);
+        rgb_planar_to_bgr8(buf, n, dst + 3 * i, scale);
+    }
+}
+
+void plane_to_gray8(const uint16_t *src, size_t count, uint8_t *dst, float scale) {
+    float buf[kHalfChunk];
+    for (size_t i = 0; i < count; i += kHalfChunk) {
+        const size_t n = std::min(kHalfChunk, count - i);
+        half_to_float(src + i, buf, n);
+        plane_to_gray8(buf, n, dst + i, scale);
+    }
+}
+
+float detect_output_scale(const uint16_t *src, size_t count) {
+    if (count == 0) return 1.f;
+    float lo = 0.f, hi = 0.f, buf[kHalfChunk];
+    for (size_t i = 0; i < count; i += kHalfChunk) {
+        const size_t n = std::min(kHalfChunk, count - i);
+        half_to_float(src + i, buf, n);
+        const auto mm = std::minmax_element(buf, buf + n);
+        lo = i ? std::min(lo, *mm.first) : *mm.first;
+        hi = i ? std::max(hi, *mm.second) : *mm.second;
+    }
+    return (lo >= 0.f && hi <= 1.f + 1e-6f) ? 255.f : 1.f;
+}
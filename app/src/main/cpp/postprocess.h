@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fused postprocessing kernels for model outputs. Values are multiplied by `scale`,
+// rounded to nearest and saturated to [0, 255]. Vectorized with NEON, AVX2 or SSSE3
+// when the target has them, scalar otherwise.
+
+// Planar RGB float (3 planes of `count`) -> interleaved BGR8 (`count` pixels).
+void rgb_planar_to_bgr8(const float *src, size_t count, uint8_t *dst, float scale);
+
+// Single float plane -> gray8.
+void plane_to_gray8(const float *src, size_t count, uint8_t *dst, float scale);
+
+// 255 when every value lies in [0, 1] (normalized output), 1 otherwise.
+float detect_output_scale(const float *src, size_t count);
+
+// Half-precision (binary16 bits) outputs: widened a cache-sized chunk at a time, then
+// through the float kernels above.
+void rgb_planar_to_bgr8(const uint16_t *src, size_t count, uint8_t *dst, float scale);
+
+void plane_to_gray8(const uint16_t *src, size_t count, uint8_t *dst, float scale);
+
+float detect_output_scale(const uint16_t *src, size_t count);
@@ -0,0 +1,160 @@
+#include "preprocess.h"
+#include "fp16.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr float kInv255 = 1.f / 255.f;
+
+// Source index pair + weight per destination coordinate (cv::INTER_LINEAR convention:
+// pixel centres aligned, edges clamped).
+struct LinearTap {
+    int i0, i1;
+    float w1;
+};
+
+std::vector<LinearTap> linear_taps(int src_len, int dst_len) {
+    std::vector<LinearTap> taps(static_cast<size_t>(dst_len));
+    const double scale = static_cast<double>(src_len) / dst_len;
+    for (int d = 0; d < dst_len; ++d) {
+        double s = (d + 0.5) * scale - 0.5;
+        int i0 = static_cast<int>(std::floor(s));
+        float w1 = static_cast<float>(s - i0);
+        if (i0 < 0) {
+            i0 = 0;
+            w1 = 0.f;
+        }
+        if (i0 >= src_len - 1) {
+            i0 = src_len - 1;
+            w1 = 0.f;
+        }
+        taps[d] = {i0, std::min(i0 + 1, src_len - 1), w1};
+    }
+    return taps;
+}
+
+// Rows are produced into the planes the sink hands out for each y, then the sink is
+// told the row is done (lets the half-precision path convert from a row buffer).
+template<typename RowSink>
+void bgr8_resample(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                   int dst_w, int dst_h, RowSink &sink) {
+    if (src_w == dst_w && src_h == dst_h) {
+        for (int y = 0; y < dst_h; ++y) {
+            const uint8_t *s = src + y * src_step;
+            float *r, *g, *b;
+            sink.rows(y, r, g, b);
+            for (int x = 0; x < dst_w; ++x) {
+                b[x] = s[3 * x + 0] * kInv255;
+                g[x] = s[3 * x + 1] * kInv255;
+                r[x] = s[3 * x + 2] * kInv255;
+            }
+            sink.done(y);
+        }
+        return;
+    }
+
+    const auto xt = linear_taps(src_w, dst_w);
+    const auto yt = linear_taps(src_h, dst_h);
+    for (int y = 0; y < dst_h; ++y) {
+        const uint8_t *s0 = src + yt[y].i0 * src_step;
+        const uint8_t *s1 = src + yt[y].i1 * src_step;
+        const float wy1 = yt[y].w1 * kInv255, wy0 = kInv255 - wy1;
+        float *r, *g, *b;
+        sink.rows(y, r, g, b);
+        for (int x = 0; x < dst_w; ++x) {
+            const int a = 3 * xt[x].i0, c = 3 * xt[x].i1;
+            const float wx1 = xt[x].w1, wx0 = 1.f - wx1;
+            auto lerp = [&](int ch) {
+                const float top = s0[a + ch] * wx0 + s0[c + ch] * wx1;
+                const float bot = s1[a + ch] * wx0 + s1[c + ch] * wx1;
+                return top * wy0 + bot * wy1;
+            };
+            // BGR -> RGB planes
+            b[x] = lerp(0);
+            g[x] = lerp(1);
+            r[x] = lerp(2);
+        }
+        sink.done(y);
+    }
+}
+
+struct FloatPlanes {
+    float *dst;
+    int w;
+    size_t plane;
+
+    void rows(int y, float *&r, float *&g, float *&b) {
+        const size_t o = static_cast<size_t>(y) * w;
+        r = dst + o;
+        g = dst + plane + o;
+        b = dst + 2 * plane + o;
+    }
+
+    void done(int) {}
+};
+
+struct HalfPlanes {
+    uint16_t *dst;
+    int w;
+    size_t plane;
+    std::vector<float> row;
+
+    void rows(int, float *&r, float *&g, float *&b) {
+        r = row.data();
+        g = r + w;
+        b = g + w;
+    }
+
+    void done(int y) {
+        const size_t o = static_cast<size_t>(y) * w;
+        for (int c = 0; c < 3; ++c)
+            float_to_half(row.data() + static_cast<size_t>(c) * w, dst + c * plane + o,
+                          static_cast<size_t>(w));
+    }
+};
+
+template<typename T>
+void mask_resample(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                   T *dst, int dst_w, int dst_h, T off, T on) {
+    std::vector<int> xs(static_cast<size_t>(dst_w));
+    const double sx = static_cast<double>(src_w) / dst_w;
+    const double sy = static_cast<double>(src_h) / dst_h;
+    for (int x = 0; x < dst_w; ++x)
+        xs[x] = std::min(static_cast<int>(std::floor(x * sx)), src_w - 1);
+
+    for (int y = 0; y < dst_h; ++y) {
+        const int src_y = std::min(static_cast<int>(std::floor(y * sy)), src_h - 1);
+        const uint8_t *s = src + src_y * src_step;
+        T *d = dst + static_cast<size_t>(y) * dst_w;
+        for (int x = 0; x < dst_w; ++x)
+            d[x] = s[xs[x]] > 127 ? on : off;
+    }
+}
+
+} // namespace
+
+void bgr8_to_rgb_planar(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                        float *dst, int dst_w, int dst_h) {
+    FloatPlanes sink{dst, dst_w, static_cast<size_t>(dst_w) * dst_h};
+    bgr8_resample(src, src_step, src_w, src_h, dst_w, dst_h, sink);
+}
+
+void bgr8_to_rgb_planar(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                        uint16_t *dst, int dst_w, int dst_h) {
+    HalfPlanes sink{dst, dst_w, static_cast<size_t>(dst_w) * dst_h,
+                    std::vector<float>(3 * static_cast<size_t>(dst_w))};
+    bgr8_resample(src, src_step, src_w, src_h, dst_w, dst_h, sink);
+}
+
+void gray8_to_mask_plane(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                         float *dst, int dst_w, int dst_h) {
+    mask_resample(src, src_step, src_w, src_h, dst, dst_w, dst_h, 0.f, 1.f);
+}
+
+void gray8_to_mask_plane(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                         uint16_t *dst, int dst_w, int dst_h) {
+    mask_resample<uint16_t>(src, src_step, src_w, src_h, dst, dst_w, dst_h, 0x0000, 0x3c00);
+}
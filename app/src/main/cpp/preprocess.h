@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+// Fused single-pass preprocessing straight into NCHW tensor memory (N=1).
+// Equivalent to cv::dnn::blobFromImage(img, 1/255, {dst_w, dst_h}, {}, swapRB, false, CV_32F)
+// with INTER_LINEAR for the image and INTER_NEAREST + threshold(127) for the mask.
+
+// BGR8 interleaved -> RGB planar float in [0, 1], bilinear resize.
+void bgr8_to_rgb_planar(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                        float *dst, int dst_w, int dst_h);
+
+// Same into half-precision (binary16 bits) planes, for FP16 models.
+void bgr8_to_rgb_planar(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                        uint16_t *dst, int dst_w, int dst_h);
+
+// Gray8 -> {0, 1} float plane, nearest resize, > 127 counts as masked.
+void gray8_to_mask_plane(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                         float *dst, int dst_w, int dst_h);
+
+void gray8_to_mask_plane(const uint8_t *src, size_t src_step, int src_w, int src_h,
+                         uint16_t *dst, int dst_w, int dst_h);
+
+// `T` is float or uint16_t (binary16)
+template<typename T>
+inline void image_to_nchw(const cv::Mat &bgr, T *dst, int dst_w, int dst_h) {
+    bgr8_to_rgb_planar(bgr.data, bgr.step, bgr.cols, bgr.rows, dst, dst_w, dst_h);
+}
+
+template<typename T>
+inline void mask_to_nchw(const cv::Mat &gray, T *dst, int dst_w, int dst_h) {
+    gray8_to_mask_plane(gray.data, gray.step, gray.cols, gray.rows, dst, dst_w, dst_h);
+}
@@ -0,0 +1,89 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+StageSummary summarize_ms(std::vector<double> samples_ms) {
+    StageSummary s;
+    if (samples_ms.empty()) return s;
+    std::sort(samples_ms.begin(), samples_ms.end());
+    auto pct = [&](double p) {
+        const size_t rank = static_cast<size_t>(p / 100.0 * (samples_ms.size() - 1) + 0.5);
+        return samples_ms[std::min(rank, samples_ms.size() - 1)];
+    };
+    s.count = samples_ms.size();
+    for (double x: samples_ms) s.mean_ms += x;
+    s.mean_ms /= static_cast<double>(samples_ms.size());
+    s.min_ms = samples_ms.front();
+    s.max_ms = samples_ms.back();
+    s.p50_ms = pct(50);
+    s.p90_ms = pct(90);
+    s.p95_ms = pct(95);
+    s.p99_ms = pct(99);
+    return s;
+}
+
+static void append_summary(std::string &out, const char *name, const StageSummary &s, bool last) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+                  "\"%s\":{\"count\":%zu,\"mean_ms\":%.3f,\"min_ms\":%.3f,\"p50_ms\":%.3f,"
+                  "\"p90_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}%s",
+                  name, s.count, s.mean_ms, s.min_ms, s.p50_ms, s.p90_ms, s.p95_ms, s.p99_ms,
+                  s.max_ms, last ? "" : ",");
+    out += buf;
+}
+
+std::string StageStats::to_json() const {
+    std::string out = "{\"recorded\":" + std::to_string(recorded) + ",\"stages\":{";
+    append_summary(out, "decode", decode, false);
+    append_summary(out, "preprocess", preprocess, false);
+    append_summary(out, "run", run, false);
+    append_summary(out, "postprocess", postprocess, false);
+    append_summary(out, "encode", encode, false);
+    append_summary(out, "total", total, true);
+    out += "}}";
+    return out;
+}
+
+StageProfiler::StageProfiler(size_t capacity) : ring_(std::max<size_t>(1, capacity)) {}
+
+void StageProfiler::record(const StageTimings &t) {
+#if CPPONNXRUNNER_PROFILING
+    std::lock_guard<std::mutex> lk(m_);
+    ring_[next_] = t;
+    next_ = (next_ + 1) % ring_.size();
+    size_ = std::min(size_ + 1, ring_.size());
+    ++recorded_;
+#else
+    (void) t;
+#endif
+}
+
+StageStats StageProfiler::stats() const {
+    std::vector<StageTimings> snapshot;
+    StageStats st;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        snapshot.assign(ring_.begin(), ring_.begin() + static_cast<std::ptrdiff_t>(size_));
+        st.recorded = recorded_;
+    }
+    std::vector<double> v(snapshot.size());
+    auto column = [&](double (*get)(const StageTimings &)) {
+        for (size_t i = 0; i < snapshot.size(); ++i) v[i] = get(snapshot[i]);
+        return summarize_ms(v);
+    };
+    st.decode = column([](const StageTimings &t) { return t.decode_ms; });
+    st.preprocess = column([](const StageTimings &t) { return t.preprocess_ms; });
+    st.run = column([](const StageTimings &t) { return t.run_ms; });
+    st.postprocess = column([](const StageTimings &t) { return t.postprocess_ms; });
+    st.encode = column([](const StageTimings &t) { return t.encode_ms; });
+    st.total = column([](const StageTimings &t) { return t.total_ms(); });
+    return st;
+}
+
+void StageProfiler::reset() {
+    std::lock_guard<std::mutex> lk(m_);
+    next_ = 0;
+    size_ = 0;
+    recorded_ = 0;
+}
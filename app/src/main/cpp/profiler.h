@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "timing.h"
+
+struct StageSummary {
+    size_t count = 0;
+    double mean_ms = 0, min_ms = 0, p50_ms = 0, p90_ms = 0, p95_ms = 0, p99_ms = 0, max_ms = 0;
+};
+
+// Nearest-rank percentiles over `samples_ms`.
+StageSummary summarize_ms(std::vector<double> samples_ms);
+
+struct StageStats {
+    uint64_t recorded = 0; // requests seen since the last reset, including evicted ones
+    StageSummary decode, preprocess, run, postprocess, encode, total;
+
+    std::string to_json() const;
+};
+
+// Ring buffer of the most recent request timings of one session.
+class StageProfiler {
+public:
+    explicit StageProfiler(size_t capacity = 256);
+
+    void record(const StageTimings &t);
+
+    StageStats stats() const;
+
+    void reset();
+
+private:
+    mutable std::mutex m_;
+    std::vector<StageTimings> ring_;
+    size_t next_ = 0;
+    size_t size_ = 0;
+    uint64_t recorded_ = 0;
+};
@@ -0,0 +1,56 @@
+#include "quality.h"
+
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+namespace {
+
+void check_pair(const cv::Mat &ref, const cv::Mat &test) {
+    if (ref.empty() || ref.size() != test.size() || ref.type() != test.type())
+        throw std::invalid_argument("quality: images must be non-empty with equal size and type");
+    if (ref.depth() != CV_8U)
+        throw std::invalid_argument("quality: 8-bit images expected");
+}
+
+cv::Mat blur(const cv::Mat &m) {
+    cv::Mat out;
+    cv::GaussianBlur(m, out, cv::Size(11, 11), 1.5);
+    return out;
+}
+
+} // namespace
+
+double psnr(const cv::Mat &ref, const cv::Mat &test) {
+    check_pair(ref, test);
+    return cv::PSNR(ref, test, 255.);
+}
+
+double ssim(const cv::Mat &ref, const cv::Mat &test) {
+    check_pair(ref, test);
+    constexpr double C1 = (0.01 * 255) * (0.01 * 255);
+    constexpr double C2 = (0.03 * 255) * (0.03 * 255);
+
+    cv::Mat x, y, xx, yy, xy;
+    ref.convertTo(x, CV_32F);
+    test.convertTo(y, CV_32F);
+    cv::multiply(x, x, xx);
+    cv::multiply(y, y, yy);
+    cv::multiply(x, y, xy);
+
+    const cv::Mat mx = blur(x), my = blur(y);
+    const cv::Mat sxx = blur(xx), syy = blur(yy), sxy = blur(xy);
+
+    // All maps are freshly allocated, hence continuous
+    const size_t n = mx.total() * static_cast<size_t>(mx.channels());
+    const auto *pmx = mx.ptr<float>(), *pmy = my.ptr<float>();
+    const auto *pxx = sxx.ptr<float>(), *pyy = syy.ptr<float>(), *pxy = sxy.ptr<float>();
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const double ux = pmx[i], uy = pmy[i];
+        const double vx = pxx[i] - ux * ux, vy = pyy[i] - uy * uy, cxy = pxy[i] - ux * uy;
+        sum += ((2 * ux * uy + C1) * (2 * cxy + C2)) /
+               ((ux * ux + uy * uy + C1) * (vx + vy + C2));
+    }
+    return sum / static_cast<double>(n);
+}
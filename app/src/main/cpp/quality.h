@@ -0,0 +1,13 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+// Full-reference image quality of `test` against `ref` (same size and type, 8-bit).
+// Used to judge reduced-precision models against the FP32 output.
+
+// Peak signal-to-noise ratio in dB over all channels; large (not inf) for identical images.
+double psnr(const cv::Mat &ref, const cv::Mat &test);
+
+// Mean structural similarity (Wang et al. 2004: 11x11 Gaussian window, sigma 1.5,
+// K1 = 0.01, K2 = 0.03), averaged over channels. 1 for identical images.
+double ssim(const cv::Mat &ref, const cv::Mat &test);
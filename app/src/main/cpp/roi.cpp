@@ -0,0 +1,68 @@
+#include "roi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+cv::Mat binarize_mask(const cv::Mat &mask, cv::Size size) {
+    cv::Mat src = mask;
+    if (src.size() != size) {
+        cv::resize(mask, src, size, 0, 0, cv::INTER_NEAREST);
+    }
+    // Into a fresh Mat: `src` may share the caller's buffer
+    cv::Mat out;
+    cv::threshold(src, out, 127, 255, cv::THRESH_BINARY);
+    return out;
+}
+
+cv::Rect mask_bounding_box(const cv::Mat &binary_mask) {
+    if (cv::countNonZero(binary_mask) == 0) return {};
+    return cv::boundingRect(binary_mask);
+}
+
+// Grow [lo, lo+len) to `target` length around its centre, kept inside [0, limit).
+static void grow_span(int &lo, int &len, int target, int limit) {
+    target = std::min(target, limit);
+    if (len >= target) return;
+    lo -= (target - len) / 2;
+    len = target;
+    lo = std::max(0, std::min(lo, limit - len));
+}
+
+cv::Rect expand_roi(const cv::Rect &bbox, cv::Size image_size, cv::Size model_size,
+                    const RoiOptions &opts) {
+    const cv::Rect image_rect(0, 0, image_size.width, image_size.height);
+    if (bbox.empty()) return image_rect;
+
+    const int longer = std::max(bbox.width, bbox.height);
+    const int pad = std::max(opts.min_context_px,
+                             static_cast<int>(std::lround(opts.context_padding * longer)));
+    cv::Rect roi(bbox.x - pad, bbox.y - pad, bbox.width + 2 * pad, bbox.height + 2 * pad);
+    roi &= image_rect;
+
+    // Match the model aspect ratio so the resize does not distort the crop.
+    const double model_aspect = static_cast<double>(model_size.width) / model_size.height;
+    int w = roi.width, h = roi.height;
+    if (w < h * model_aspect) {
+        w = static_cast<int>(std::ceil(h * model_aspect));
+    } else {
+        h = static_cast<int>(std::ceil(w / model_aspect));
+    }
+    // Never feed less than the model input when the image has the pixels for it.
+    w = std::max(w, model_size.width);
+    h = std::max(h, model_size.height);
+
+    grow_span(roi.x, roi.width, w, image_size.width);
+    grow_span(roi.y, roi.height, h, image_size.height);
+    return roi;
+}
+
+void composite_roi(cv::Mat &dst, const cv::Rect &roi, const cv::Mat &patch,
+                   const cv::Mat &binary_mask_roi) {
+    cv::Mat resized = patch;
+    if (resized.size() != roi.size()) {
+        cv::resize(patch, resized, roi.size(), 0, 0, cv::INTER_LINEAR);
+    }
+    cv::Mat dst_roi = dst(roi);
+    resized.copyTo(dst_roi, binary_mask_roi);
+}
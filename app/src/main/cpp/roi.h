@@ -0,0 +1,19 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include "config.h"
+
+// Resize the mask to `size` (nearest) and binarize it to {0, 255}.
+cv::Mat binarize_mask(const cv::Mat &mask, cv::Size size);
+
+// Bounding box of the non-zero pixels, empty rect if there are none.
+cv::Rect mask_bounding_box(const cv::Mat &binary_mask);
+
+// Grow the mask bbox by the configured context, then towards the model's aspect
+// ratio and at least the model size so the crop is fed at (near) native resolution.
+cv::Rect expand_roi(const cv::Rect &bbox, cv::Size image_size, cv::Size model_size,
+                    const RoiOptions &opts);
+
+// Resize `patch` to `roi` and paste it into `dst` where `binary_mask_roi` is set.
+void composite_roi(cv::Mat &dst, const cv::Rect &roi, const cv::Mat &patch,
+                   const cv::Mat &binary_mask_roi);
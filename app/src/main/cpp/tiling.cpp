@@ -0,0 +1,109 @@
+#include "tiling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+// Tile origins along one axis covering [lo, lo+len) inside [0, limit).
+static std::vector<int> tile_starts(int lo, int len, int tile, int overlap, int limit) {
+    const int max_start = std::max(0, limit - tile);
+    if (len <= tile) {
+        return {std::max(0, std::min(lo + len / 2 - tile / 2, max_start))};
+    }
+    const int stride = std::max(1, tile - overlap);
+    const int n = 1 + (len - tile + stride - 1) / stride;
+    std::vector<int> starts;
+    starts.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        // spread evenly so the real overlap is >= the requested one
+        const int s = lo + static_cast<int>(std::lround(
+                static_cast<double>(i) * (len - tile) / (n - 1)));
+        starts.push_back(std::max(0, std::min(s, max_start)));
+    }
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+    return starts;
+}
+
+std::vector<cv::Rect> plan_tiles(const cv::Rect &bbox, const cv::Mat &binary_mask,
+                                 cv::Size tile, int overlap) {
+    const cv::Rect image_rect(0, 0, binary_mask.cols, binary_mask.rows);
+    overlap = std::max(0, std::min(overlap, std::min(tile.width, tile.height) / 2));
+    const cv::Rect region = cv::Rect(bbox.x - overlap, bbox.y - overlap,
+                                     bbox.width + 2 * overlap,
+                                     bbox.height + 2 * overlap) & image_rect;
+
+    std::vector<cv::Rect> tiles;
+    for (int y: tile_starts(region.y, region.height, tile.height, overlap, image_rect.height)) {
+        for (int x: tile_starts(region.x, region.width, tile.width, overlap, image_rect.width)) {
+            const cv::Rect r = cv::Rect(x, y, tile.width, tile.height) & image_rect;
+            if (cv::countNonZero(binary_mask(r)) > 0)
+                tiles.push_back(r);
+        }
+    }
+    return tiles;
+}
+
+// 1-D ramp rising over `overlap` px at both ends, never reaching zero.
+static std::vector<float> feather_ramp(int len, int overlap) {
+    std::vector<float> ramp(static_cast<size_t>(len), 1.f);
+    if (overlap <= 0) return ramp;
+    for (int i = 0; i < len; ++i) {
+        const float d = static_cast<float>(std::min(i, len - 1 - i)) + 0.5f;
+        ramp[i] = std::min(1.f, d / static_cast<float>(overlap));
+    }
+    return ramp;
+}
+
+TileBlender::TileBlender(const cv::Rect &region, cv::Size tile, int overlap)
+        : acc_(region.size(), CV_32FC3, cv::Scalar::all(0)),
+          wsum_(region.size(), CV_32F, cv::Scalar::all(0)),
+          region_(region) {
+    const auto rx = feather_ramp(tile.width, overlap);
+    const auto ry = feather_ramp(tile.height, overlap);
+    weights_.create(tile, CV_32F);
+    for (int y = 0; y < tile.height; ++y) {
+        auto *w = weights_.ptr<float>(y);
+        for (int x = 0; x < tile.width; ++x)
+            w[x] = rx[x] * ry[y];
+    }
+}
+
+void TileBlender::add(const cv::Rect &rect, const cv::Mat &patch) {
+    cv::Mat src = patch;
+    if (src.size() != rect.size())
+        cv::resize(patch, src, rect.size(), 0, 0, cv::INTER_LINEAR);
+
+    cv::Mat weights = weights_;
+    if (weights.size() != rect.size())
+        cv::resize(weights_, weights, rect.size(), 0, 0, cv::INTER_LINEAR);
+
+    for (int y = 0; y < rect.height; ++y) {
+        const auto *p = src.ptr<uint8_t>(y);
+        const auto *w = weights.ptr<float>(y);
+        const int ry = rect.y - region_.y + y, rx = rect.x - region_.x;
+        auto *a = acc_.ptr<float>(ry) + 3 * rx;
+        auto *s = wsum_.ptr<float>(ry) + rx;
+        for (int x = 0; x < rect.width; ++x) {
+            a[3 * x + 0] += w[x] * p[3 * x + 0];
+            a[3 * x + 1] += w[x] * p[3 * x + 1];
+            a[3 * x + 2] += w[x] * p[3 * x + 2];
+            s[x] += w[x];
+        }
+    }
+}
+
+void TileBlender::composite(cv::Mat &dst, const cv::Mat &binary_mask) const {
+    for (int y = 0; y < region_.height; ++y) {
+        const auto *m = binary_mask.ptr<uint8_t>(region_.y + y) + region_.x;
+        const auto *a = acc_.ptr<float>(y);
+        const auto *s = wsum_.ptr<float>(y);
+        auto *d = dst.ptr<uint8_t>(region_.y + y) + 3 * region_.x;
+        for (int x = 0; x < region_.width; ++x) {
+            if (!m[x] || s[x] <= 0.f) continue;
+            const float inv = 1.f / s[x];
+            d[3 * x + 0] = cv::saturate_cast<uint8_t>(a[3 * x + 0] * inv);
+            d[3 * x + 1] = cv::saturate_cast<uint8_t>(a[3 * x + 1] * inv);
+            d[3 * x + 2] = cv::saturate_cast<uint8_t>(a[3 * x + 2] * inv);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Cover the mask bbox (plus `overlap` px of context) with tiles of `tile` size that
+// overlap by at least `overlap` px. Tiles without any mask pixel are dropped.
+std::vector<cv::Rect> plan_tiles(const cv::Rect &bbox, const cv::Mat &binary_mask,
+                                 cv::Size tile, int overlap);
+
+// Accumulates overlapping BGR tiles with linear feathering towards tile edges.
+// Buffers only cover `region` (image coordinates), normally the union of the tiles.
+class TileBlender {
+public:
+    TileBlender(const cv::Rect &region, cv::Size tile, int overlap);
+
+    void add(const cv::Rect &rect, const cv::Mat &patch);
+
+    // Paste the blended pixels into `dst` where `binary_mask` is set.
+    void composite(cv::Mat &dst, const cv::Mat &binary_mask) const;
+
+private:
+    cv::Mat weights_; // CV_32F, tile sized
+    cv::Mat acc_;     // CV_32FC3, region sized
+    cv::Mat wsum_;    // CV_32F, region sized
+    cv::Rect region_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+
+// Stage timers are compiled in unless the build sets CPPONNXRUNNER_PROFILING=0.
+#ifndef CPPONNXRUNNER_PROFILING
+#define CPPONNXRUNNER_PROFILING 1
+#endif
+
+using StageClock = std::chrono::steady_clock;
+
+inline double elapsed_ms(StageClock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(StageClock::now() - t0).count();
+}
+
+// Wall time per pipeline stage of one request, in ms. Tiled runs sum their tiles.
+struct StageTimings {
+    double decode_ms      = 0;
+    double preprocess_ms  = 0;
+    double run_ms         = 0;
+    double postprocess_ms = 0;
+    double encode_ms      = 0;
+
+    // Served from the result cache: no stage ran, so the zeros are not latencies
+    bool cache_hit = false;
+
+    double total_ms() const {
+        return decode_ms + preprocess_ms + run_ms + postprocess_ms + encode_ms;
+    }
+
+    StageTimings &operator+=(const StageTimings &o) {
+        decode_ms += o.decode_ms;
+        preprocess_ms += o.preprocess_ms;
+        run_ms += o.run_ms;
+        postprocess_ms += o.postprocess_ms;
+        encode_ms += o.encode_ms;
+        return *this;
+    }
+};
+
+#if CPPONNXRUNNER_PROFILING
+// Adds the lifetime of the enclosing scope to `acc_ms`.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(double &acc_ms) : acc_ms_(acc_ms), t0_(StageClock::now()) {}
+
+    ~ScopedStageTimer() { acc_ms_ += elapsed_ms(t0_); }
+
+    ScopedStageTimer(const ScopedStageTimer &) = delete;
+    ScopedStageTimer &operator=(const ScopedStageTimer &) = delete;
+
+private:
+    double &acc_ms_;
+    StageClock::time_point t0_;
+};
+
+#define STAGE_TIMER_CAT_(a, b) a##b
+#define STAGE_TIMER_CAT(a, b) STAGE_TIMER_CAT_(a, b)
+#define STAGE_TIMER(acc_ms) ScopedStageTimer STAGE_TIMER_CAT(stage_timer_, __LINE__)(acc_ms)
+#else
+#define STAGE_TIMER(acc_ms) ((void) 0)
+#endif
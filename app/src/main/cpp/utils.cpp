@@ -1,4 +1,5 @@
 #include "utils.h"
+#include <android/bitmap.h>
 #include <limits>
 
 std::vector<uint8_t> JByteArrayToVector(JNIEnv *env, jbyteArray arr) {
@@ -69,3 +70,46 @@ std::string JString2String(JNIEnv *env, jstring jStr) {
     return ret;
 }
 
+
+ScopedJniEnv::ScopedJniEnv(JavaVM *vm) : vm_(vm) {
+    if (!vm_) return;
+    const jint rc = vm_->GetEnv(reinterpret_cast<void **>(&env_), JNI_VERSION_1_6);
+    if (rc == JNI_EDETACHED) {
+        attached_ = vm_->AttachCurrentThread(&env_, nullptr) == JNI_OK;
+        if (!attached_) env_ = nullptr;
+    } else if (rc != JNI_OK) {
+        env_ = nullptr;
+    }
+}
+
+ScopedJniEnv::~ScopedJniEnv() {
+    if (attached_) vm_->DetachCurrentThread();
+}
+
+DirectBytes DirectBufferBytes(JNIEnv *env, jobject buffer) {
+    if (!env || !buffer) return {};
+    void *data = env->GetDirectBufferAddress(buffer);
+    const jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!data || capacity < 0) return {};
+    return {static_cast<uint8_t *>(data), static_cast<size_t>(capacity)};
+}
+
+LockedBitmap::LockedBitmap(JNIEnv *env, jobject bitmap) : env_(env), bitmap_(bitmap) {
+    AndroidBitmapInfo info{};
+    if (!env_ || !bitmap_ || AndroidBitmap_getInfo(env_, bitmap_, &info) != ANDROID_BITMAP_RESULT_SUCCESS)
+        return;
+    int type;
+    if (info.format == ANDROID_BITMAP_FORMAT_RGBA_8888) type = CV_8UC4;
+    else if (info.format == ANDROID_BITMAP_FORMAT_A_8) type = CV_8UC1;
+    else return;
+    void *pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env_, bitmap_, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS || !pixels)
+        return;
+    locked_ = true;
+    mat_ = cv::Mat(static_cast<int>(info.height), static_cast<int>(info.width), type, pixels,
+                   info.stride);
+}
+
+LockedBitmap::~LockedBitmap() {
+    if (locked_) AndroidBitmap_unlockPixels(env_, bitmap_);
+}
@@ -1,10 +1,58 @@
 #pragma once
 #include <string>
 #include <jni.h>
+#include <opencv2/core.hpp>
 #include <vector>
 #include <string>
 
 std::vector<uint8_t> JByteArrayToVector(JNIEnv* env, jbyteArray arr);
 jbyteArray VectorToJByteArray(JNIEnv* env, const std::vector<uint8_t>& v);
 std::vector<std::string> JStringArrayToVector(JNIEnv* env, jobjectArray arr);
-std::string JString2String(JNIEnv *env, jstring jStr);
\ No newline at end of file
+std::string JString2String(JNIEnv *env, jstring jStr);
+// Memory of a direct java.nio.ByteBuffer, used in place (no copy); data is null for heap
+// buffers. Valid while the buffer is reachable from Java.
+struct DirectBytes {
+    uint8_t *data = nullptr;
+    size_t size = 0; // capacity, ignoring position and limit
+};
+DirectBytes DirectBufferBytes(JNIEnv *env, jobject buffer);
+// Pixels of an android.graphics.Bitmap, locked for the guard's lifetime. RGBA_8888 bitmaps
+// map to CV_8UC4 (R, G, B, A byte order) and A_8 to CV_8UC1; other formats and lock
+// failures leave mat() empty.
+class LockedBitmap {
+public:
+    LockedBitmap(JNIEnv *env, jobject bitmap);
+    ~LockedBitmap();
+
+    LockedBitmap(const LockedBitmap &) = delete;
+    LockedBitmap &operator=(const LockedBitmap &) = delete;
+
+    // Wraps the bitmap memory (row stride included); valid while the guard lives.
+    cv::Mat &mat() { return mat_; }
+
+    bool rgba() const { return mat_.type() == CV_8UC4; }
+
+private:
+    JNIEnv *env_;
+    jobject bitmap_;
+    bool locked_ = false;
+    cv::Mat mat_;
+};
+
+// JNIEnv of the current thread, attaching it to the VM for the guard's lifetime when it
+// is a native thread (scheduler workers calling back into Java). get() is null on failure.
+class ScopedJniEnv {
+public:
+    explicit ScopedJniEnv(JavaVM *vm);
+    ~ScopedJniEnv();
+
+    ScopedJniEnv(const ScopedJniEnv &) = delete;
+    ScopedJniEnv &operator=(const ScopedJniEnv &) = delete;
+
+    JNIEnv *get() const { return env_; }
+
+private:
+    JavaVM *vm_;
+    JNIEnv *env_ = nullptr;
+    bool attached_ = false;
+};
@@ -3,6 +3,7 @@ package com.example.cpponnxrunner
 import android.Manifest
 import android.content.Intent
 import android.content.pm.PackageManager
+import android.content.res.AssetManager
 import android.graphics.Bitmap
 import android.graphics.BitmapFactory
 import android.os.Bundle
@@ -20,6 +21,8 @@ import com.example.cpponnxrunner.databinding.ActivityMainBinding
 import java.io.File
 import java.io.FileOutputStream
 import java.io.IOException
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.util.Locale
 import java.util.concurrent.Executors
 
@@ -35,6 +38,10 @@ class MainActivity : AppCompatActivity() {
     private val SAMPLE_MASK_ASSET = "images/dilated_mask.png"
     private val OUTPUT_IMAGE_PATH = "output/output_image.png"
 
+    // Sweep RunnerSettings once per device after the first load (takes minutes); the stored
+    // profile is picked up by createSession on later starts
+    private val AUTO_TUNE = false
+
     private lateinit var binding: ActivityMainBinding
     private val PICK_IMAGE = 1000
     private val CAPTURE_IMAGE = 2000
@@ -64,15 +71,7 @@ class MainActivity : AppCompatActivity() {
         binding = ActivityMainBinding.inflate(layoutInflater)
         setContentView(binding.root)
 
-        // --- Copy Assets -> Cache ---
-        copyAssetToCacheDir(
-            MODEL_ASSET_PATH,
-            MODEL_ASSET_PATH
-        )         // => $cacheDir/inference.onnx
-        copyAssetToCacheDir(
-            Model_2_ASSET_PATH,
-            Model_2_ASSET_PATH
-        )     // => $cacheDir/inference_1.onnx
+        // --- Copy Assets -> Cache --- (models are mapped from the APK, see createSessionFromAssets)
         copyFileOrDir("images")                                     // => $cacheDir/images/* (for sample input & mask)
 
         val copiedDir = File(cacheDir, "images")
@@ -82,16 +81,32 @@ class MainActivity : AppCompatActivity() {
         )
 
         // Create ORT session in background; measure duration; show English toasts
-        val modelPath = File(cacheDir, MODEL_ASSET_PATH).absolutePath
-        val model2Path = File(cacheDir, Model_2_ASSET_PATH).absolutePath
         mainHandler.post {
             Toast.makeText(this, "Loading model…", Toast.LENGTH_SHORT).show()
         }
         val t0Load = SystemClock.elapsedRealtime()
         bg.execute {
             try {
-                val modelPaths: Array<String> = arrayOf(modelPath, model2Path);
-                createSession(modelPaths)
+                val optimizedDir = File(cacheDir, "ort_optimized").absolutePath
+                val profileDir = File(filesDir, "runner_profiles").absolutePath
+                val resultDir = File(cacheDir, "inference_results").absolutePath
+                val modelAssets: Array<String> = arrayOf(MODEL_ASSET_PATH, Model_2_ASSET_PATH)
+                try {
+                    createSessionFromAssets(assets, modelAssets, optimizedDir, profileDir, resultDir)
+                } catch (e: RuntimeException) {
+                    // asset stored compressed: fall back to a copy in cacheDir
+                    Log.w("cpponnxrunner", "mapping model assets failed, copying", e)
+                    val modelPaths: Array<String> =
+                        modelAssets.map { copyAssetToCacheDir(it, it) }.toTypedArray()
+                    createSession(modelPaths, optimizedDir, profileDir, resultDir)
+                }
+                if (AUTO_TUNE) {
+                    val imageBytes = assets.open(SAMPLE_IMAGE_ASSET).use { it.readBytes() }
+                    val maskBytes = assets.open(SAMPLE_MASK_ASSET).use { it.readBytes() }
+                    autoTune(imageBytes, maskBytes, false)?.let {
+                        Log.i("cpponnxrunner", "tuned settings stored to $it")
+                    }
+                }
                 val dtMs = SystemClock.elapsedRealtime() - t0Load
                 val dtSec = dtMs / 1000.0
                 mainHandler.post {
@@ -202,6 +217,14 @@ class MainActivity : AppCompatActivity() {
         }
 
         try {
+            if (requestCode == CAPTURE_IMAGE) {
+                // Camera intent returns a thumbnail bitmap; run on its pixels directly
+                val bmp = data?.extras?.get("data") as? Bitmap ?: return
+                binding.cameraSetting.isChecked = true
+                runBitmapInference(bmp, sourceLabel = "camera")
+                return
+            }
+
             // 1) Input image -> ByteArray
             val imageBytes: ByteArray = when (requestCode) {
                 PICK_IMAGE -> {
@@ -211,29 +234,16 @@ class MainActivity : AppCompatActivity() {
                     }
                 }
 
-                CAPTURE_IMAGE -> {
-                    // Camera intent returns a thumbnail; compress to PNG and convert to bytes
-                    val bmp = data?.extras?.get("data") as? Bitmap ?: return
-                    java.io.ByteArrayOutputStream().use { bos ->
-                        bmp.compress(Bitmap.CompressFormat.PNG, 100, bos)
-                        bos.toByteArray()
-                    }
-                }
-
                 else -> return
             }
 
 
             val maskBytes: ByteArray = assets.open(SAMPLE_MASK_ASSET).use { it.readBytes() }
 
-            if (requestCode == CAPTURE_IMAGE) {
-                binding.cameraSetting.isChecked = true
-            }
-
             runInference(
                 imageBytes = imageBytes,
                 maskBytes = maskBytes,
-                sourceLabel = if (requestCode == CAPTURE_IMAGE) "camera" else "gallery"
+                sourceLabel = "gallery"
             )
 
         } catch (t: Throwable) {
@@ -249,6 +259,8 @@ class MainActivity : AppCompatActivity() {
     override fun onDestroy() {
         super.onDestroy()
         try {
+            cancelInference()
+            endEdit()
             releaseSession()
         } catch (t: Throwable) {
             Log.w("cpponnxrunner", "releaseSession failed", t)
@@ -256,7 +268,7 @@ class MainActivity : AppCompatActivity() {
     }
 
     // Inference helpers
-    private fun runInference(imageBytes: ByteArray, maskBytes: ByteArray, sourceLabel: String) {
+    private fun startInference(sourceLabel: String) {
         // Re-entry guard + UI
         mainHandler.post {
             isInferencing = true
@@ -266,53 +278,131 @@ class MainActivity : AppCompatActivity() {
             binding.statusMessage.text = "Running inference… ($sourceLabel)"
             Toast.makeText(this, "Inference started…", Toast.LENGTH_SHORT).show()
         }
+    }
+
+    private fun runInference(imageBytes: ByteArray, maskBytes: ByteArray, sourceLabel: String) {
+        startInference(sourceLabel)
+
+        val t0Infer = SystemClock.elapsedRealtime()
+        // Preview first (when the full pass is expensive), then the full result; a newer
+        // request cancels this one. Started off the UI thread, since queueing may block.
+        // Raw RGBA skips encoding for display; only the saved copy is compressed
+        bg.execute {
+            inferProgressive(imageBytes, maskBytes, FORMAT_RAW_RGBA, 0, object : ProgressiveListener {
+                override fun onPreview(image: ByteArray) {
+                    val dtSec = (SystemClock.elapsedRealtime() - t0Infer) / 1000.0
+                    val bmp = rawRgbaToBitmap(image)
+                    mainHandler.post {
+                        binding.outputImage.setImageBitmap(bmp)
+                        binding.statusMessage.text =
+                            String.format(Locale.US, "Preview (%.2f s), refining…", dtSec)
+                    }
+                }
+
+                override fun onResult(image: ByteArray?) {
+                    if (image == null) {
+                        mainHandler.post {
+                            binding.statusMessage.text = "Inference cancelled"
+                            finishInference()
+                        }
+                        return
+                    }
+                    val dtMs = SystemClock.elapsedRealtime() - t0Infer
+                    val dtSec = dtMs / 1000.0
+                    val outBitmap = rawRgbaToBitmap(image)
+                    val outPath = writeBitmapToCache(OUTPUT_IMAGE_PATH, outBitmap)
+                    Log.i("cpponnxrunner", "stage stats: ${stageStats()}")
+
+                    mainHandler.post {
+                        Log.i("cpponnxrunner", "Output saved to: $outPath")
+                        try {
+                            binding.outputImage.setImageBitmap(outBitmap)
+                            binding.statusMessage.text =
+                                String.format(Locale.US, "Output rendered (%.2f s)", dtSec)
+                        } catch (_: Throwable) {
+                            binding.statusMessage.text =
+                                String.format(Locale.US, "Output saved to: %s (%.2f s)", outPath, dtSec)
+                        }
+                        val inBitmap = BitmapFactory.decodeByteArray(imageBytes, 0, imageBytes.size)
+                        binding.inputImage.setImageBitmap(inBitmap)
+
+                        Toast.makeText(
+                            this@MainActivity,
+                            String.format(Locale.US, "Inference finished (%.2f s)", dtSec),
+                            Toast.LENGTH_LONG
+                        ).show()
+                        finishInference()
+                    }
+                }
+
+                override fun onError(message: String) {
+                    Log.e("cpponnxrunner", "inference failed: $message")
+                    mainHandler.post {
+                        binding.statusMessage.text = "Inference error: $message"
+                        Toast.makeText(this@MainActivity, "Inference error: $message", Toast.LENGTH_LONG)
+                            .show()
+                        finishInference()
+                    }
+                }
+            })
+        }
+    }
+
+    // Bitmap in, bitmap out (inferToBitmap): no PNG encode/decode on either side
+    private fun runBitmapInference(image: Bitmap, sourceLabel: String) {
+        startInference(sourceLabel)
 
         val t0Infer = SystemClock.elapsedRealtime()
         bg.execute {
             try {
-                val outBytes: ByteArray = inferFromBytes(imageBytes, maskBytes)
-                val outPath = writeBytesToCache(OUTPUT_IMAGE_PATH, outBytes)
-                val dtMs = SystemClock.elapsedRealtime() - t0Infer
-                val dtSec = dtMs / 1000.0
+                val input = if (image.config == Bitmap.Config.ARGB_8888) image
+                else image.copy(Bitmap.Config.ARGB_8888, false)
+                val mask = assets.open(SAMPLE_MASK_ASSET).use { BitmapFactory.decodeStream(it) }
+                    ?: throw IOException("cannot decode $SAMPLE_MASK_ASSET")
+                val outBitmap = inferToBitmap(input, mask)
+                mask.recycle()
+                if (outBitmap == null) {
+                    mainHandler.post {
+                        binding.statusMessage.text = "Inference error: see log"
+                        finishInference()
+                    }
+                    return@execute
+                }
+                val dtSec = (SystemClock.elapsedRealtime() - t0Infer) / 1000.0
+                val outPath = writeBitmapToCache(OUTPUT_IMAGE_PATH, outBitmap)
+                Log.i("cpponnxrunner", "stage stats: ${stageStats()}")
 
                 mainHandler.post {
                     Log.i("cpponnxrunner", "Output saved to: $outPath")
-                    val outBitmap = BitmapFactory.decodeByteArray(outBytes, 0, outBytes.size)
-                    try {
-                        binding.outputImage.setImageBitmap(outBitmap)
-                        binding.statusMessage.text =
-                            String.format(Locale.US, "Output rendered (%.2f s)", dtSec)
-                    } catch (_: Throwable) {
-                        binding.statusMessage.text =
-                            String.format(Locale.US, "Output saved to: %s (%.2f s)", outPath, dtSec)
-                    }
-                    val inBitmap = BitmapFactory.decodeByteArray(imageBytes, 0, imageBytes.size)
-                    binding.inputImage.setImageBitmap(inBitmap)
-
+                    binding.outputImage.setImageBitmap(outBitmap)
+                    binding.inputImage.setImageBitmap(input)
+                    binding.statusMessage.text =
+                        String.format(Locale.US, "Output rendered (%.2f s)", dtSec)
                     Toast.makeText(
-                        this,
+                        this@MainActivity,
                         String.format(Locale.US, "Inference finished (%.2f s)", dtSec),
                         Toast.LENGTH_LONG
                     ).show()
-                    isInferencing = false
-                    if (this::inferButton.isInitialized) {
-                        inferButton.isEnabled = true
-                    }
+                    finishInference()
                 }
-            } catch (e: Throwable) {
-                Log.e("cpponnxrunner", "inference failed", e)
+            } catch (t: Throwable) {
+                Log.e("cpponnxrunner", "bitmap inference failed", t)
                 mainHandler.post {
-                    binding.statusMessage.text = "Inference error: ${e.message}"
-                    Toast.makeText(this, "Inference error: ${e.message}", Toast.LENGTH_LONG).show()
-                    isInferencing = false
-                    if (this::inferButton.isInitialized) {
-                        inferButton.isEnabled = true
-                    }
+                    binding.statusMessage.text = "Inference error: ${t.message}"
+                    finishInference()
                 }
             }
         }
     }
 
+    // main thread
+    private fun finishInference() {
+        isInferencing = false
+        if (this::inferButton.isInitialized) {
+            inferButton.isEnabled = true
+        }
+    }
+
     // =========================
     // Helpers (assets/cache IO)
     // =========================
@@ -373,11 +463,110 @@ class MainActivity : AppCompatActivity() {
     // JNI bridges
     // =========================
 
-    external fun createSession(modelPaths: Array<String>)
+    external fun createSession(
+        modelPaths: Array<String>,
+        optimizedCacheDir: String,
+        profileDir: String,
+        resultCacheDir: String
+    )
+
+    /** maps uncompressed model assets directly from the APK; throws RuntimeException otherwise */
+    external fun createSessionFromAssets(
+        assetManager: AssetManager,
+        assetNames: Array<String>,
+        optimizedCacheDir: String,
+        profileDir: String,
+        resultCacheDir: String
+    )
+
+    /** tunes RunnerSettings on the sample and reloads; null when a stored profile exists and !force */
+    external fun autoTune(image: ByteArray, mask: ByteArray, force: Boolean): String?
     external fun inferFromBytes(image: ByteArray, mask: ByteArray): ByteArray
+
+    /**
+     * inference straight on bitmap memory, skipping the PNG round trips of inferFromBytes:
+     * image and mask are ARGB_8888 or ALPHA_8, the result is scaled into out (ARGB_8888)
+     */
+    external fun inferBitmap(image: Bitmap, mask: Bitmap, out: Bitmap): Boolean
+
+    /** pixels as Bitmap.getPixels returns them plus a width * height byte mask; ARGB result */
+    external fun inferArgb(pixels: IntArray, mask: ByteArray, width: Int, height: Int): IntArray?
+
+    /**
+     * inferFromBytes reading the first imageLength / maskLength bytes of direct buffers
+     * (ByteBuffer.allocateDirect) in place, without copying them into native memory
+     */
+    external fun inferDirect(image: ByteBuffer, imageLength: Int, mask: ByteBuffer, maskLength: Int): ByteArray?
+
+    /**
+     * inferDirect writing the result into the direct buffer out: returns its size, 0 on
+     * failure, or minus the required capacity when out is too small
+     */
+    external fun inferDirectInto(
+        image: ByteBuffer, imageLength: Int,
+        mask: ByteBuffer, maskLength: Int,
+        out: ByteBuffer
+    ): Int
+
+    /** inferBitmap into a new bitmap the size of image, or null on failure */
+    private fun inferToBitmap(image: Bitmap, mask: Bitmap): Bitmap? {
+        val out = Bitmap.createBitmap(image.width, image.height, Bitmap.Config.ARGB_8888)
+        if (inferBitmap(image, mask, out)) return out
+        out.recycle()
+        return null
+    }
+
+    /** bitmap of a FORMAT_RAW_RGBA result: "RGBA", width, height (LE uint32), then pixels */
+    private fun rawRgbaToBitmap(raw: ByteArray): Bitmap {
+        val header = ByteBuffer.wrap(raw, 0, 12).order(ByteOrder.LITTLE_ENDIAN)
+        header.position(4)
+        val width = header.int
+        val height = header.int
+        val bmp = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888)
+        bmp.copyPixelsFromBuffer(ByteBuffer.wrap(raw, 12, width * height * 4))
+        return bmp
+    }
+
+    /** callbacks of inferProgressive, invoked on a native worker thread */
+    interface ProgressiveListener {
+        fun onPreview(image: ByteArray)
+
+        /** full result, or null when the request was cancelled */
+        fun onResult(image: ByteArray?)
+
+        fun onError(message: String)
+    }
+
+    /**
+     * preview (if worthwhile) then full result through `listener`; cancels the previous request.
+     * Both come as FORMAT_PNG (level = deflate 0-9), FORMAT_JPEG (level = quality),
+     * FORMAT_WEBP_LOSSLESS, or FORMAT_RAW_RGBA for display without any compression
+     * (see rawRgbaToBitmap)
+     */
+    external fun inferProgressive(
+        image: ByteArray, mask: ByteArray,
+        format: Int, level: Int,
+        listener: ProgressiveListener
+    )
+
+    /** cancels the in-flight inferProgressive request, if any */
+    external fun cancelInference()
+
+    /** starts stroke-by-stroke editing of `image` (replacing any previous edit session) */
+    external fun beginEdit(image: ByteArray)
+
+    /** PNG for the whole current mask; only regions the mask change touched are recomputed */
+    external fun applyEdit(mask: ByteArray): ByteArray?
+
+    external fun endEdit()
     external fun releaseSession()
 
     companion object {
+        const val FORMAT_PNG = 0
+        const val FORMAT_JPEG = 1
+        const val FORMAT_WEBP_LOSSLESS = 2
+        const val FORMAT_RAW_RGBA = 3
+
         init {
             System.loadLibrary("cpponnxrunner")
         }
@@ -385,6 +574,9 @@ class MainActivity : AppCompatActivity() {
 
     external fun cvVersion(): String
 
+    /** JSON per-stage latency stats (count, mean, p50/p95/p99) of recent native requests */
+    external fun stageStats(): String
+
     /** copies assets/<assetPath> to $cacheDir/<targetRelative> */
     private fun copyAssetToCache(targetRelative: String, assetPath: String) {
         ensureCacheParents(targetRelative)
@@ -397,11 +589,11 @@ class MainActivity : AppCompatActivity() {
         }
     }
 
-    /** writes $cacheDir/<relative> (creating parent folders if needed) and returns the absolute path */
-    private fun writeBytesToCache(relative: String, data: ByteArray): String {
+    /** writes bmp as PNG to $cacheDir/<relative> and returns the absolute path */
+    private fun writeBitmapToCache(relative: String, bmp: Bitmap): String {
         ensureCacheParents(relative)
         val outFile = File(cacheDir, relative)
-        FileOutputStream(outFile).use { it.write(data) }
+        FileOutputStream(outFile).use { bmp.compress(Bitmap.CompressFormat.PNG, 100, it) }
         return outFile.absolutePath
     }
 